@@ -25,6 +25,7 @@ namespace snow {
 	ObjectPtr<Array> array_concatenate(ArrayConstPtr a, ArrayConstPtr b);
 	bool array_contains(ArrayConstPtr a, Value val);
 	int32_t array_index_of(ArrayConstPtr a, Value val);
+	bool array_get_storage_layout(int32_t* out_begin_offset, int32_t* out_end_offset); // for inline element access in generated code
 	
 	ObjectPtr<Class> get_array_class();
 }
@@ -56,7 +56,7 @@ namespace snow {
 			struct { ASTNode *parameters, *body; }          closure;
 			struct { Symbol name; ASTNode *id_type, *default_value; } parameter;
 			struct { ASTNode *value; }                   return_expr;
-			struct { Symbol name; }                      identifier;
+			struct { Symbol name; ASTNode *id_type; }    identifier; // id_type only for assignment targets
 			struct { ASTNode *target, *value; }          assign;
 			struct { ASTNode *object; Symbol name; }     method;
 			struct { ASTNode *object; Symbol name; }     instance_variable;
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef CHANNEL_HPP_QW4N8ZLE
+#define CHANNEL_HPP_QW4N8ZLE
+
+#include "snow/object.hpp"
+#include "snow/objectptr.hpp"
+
+namespace snow {
+	struct Channel;
+	struct Class;
+	typedef ObjectPtr<Channel> ChannelPtr;
+	typedef ObjectPtr<const Channel> ChannelConstPtr;
+	
+	// Channels pass values between the fibers of one isolate. Like every object, a channel
+	// belongs to its isolate's heap, so it cannot be shared with another isolate's thread.
+	static const int32_t SN_CHANNEL_UNBOUNDED = -1;
+	
+	ObjectPtr<Channel> create_channel(int32_t capacity = SN_CHANNEL_UNBOUNDED); // capacity 0 hands values directly from sender to receiver
+	void channel_send(ChannelPtr channel, Value value); // parks the current fiber while the channel is full
+	Value channel_receive(ChannelPtr channel, bool* out_closed = NULL); // parks the current fiber while the channel is empty; nil when closed
+	bool channel_try_receive(ChannelPtr channel, Value* out_value);
+	void channel_close(ChannelPtr channel);
+	bool channel_is_closed(ChannelConstPtr channel);
+	size_t channel_size(ChannelConstPtr channel);
+	size_t channel_select(const ChannelPtr* channels, size_t num_channels, Value* out_value, bool* out_closed = NULL); // receive from whichever is ready first, returns its index; nil when closed
+	
+	ObjectPtr<Class> get_channel_class();
+}
+
+#endif /* end of include guard: CHANNEL_HPP_QW4N8ZLE */
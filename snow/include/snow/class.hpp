@@ -51,6 +51,10 @@ namespace snow {
 	// Methods and Properties API
 	bool class_lookup_method(ClassConstPtr cls, Symbol name, MethodQueryResult* out_method);
 	bool class_lookup_property_setter(ClassConstPtr cls, Symbol name, MethodQueryResult* out_method);
+	void class_invalidate_method_cache(); // must be called when a class may have been freed or changed
+	ClassConstPtr class_get_super(ClassConstPtr cls);
+	ClassConstPtr class_get_method_owner(ClassConstPtr cls, Symbol name);
+	const uint32_t* class_get_methods_version(ClassConstPtr cls); // for guarding code that binds methods at compile time
 	ClassPtr _class_define_method(ClassPtr cls, Symbol name, Value function);
 	ClassPtr _class_define_property(ClassPtr cls, Symbol name, Value getter, Value setter);
 	void _register_binding(ClassPtr cls, Symbol name, void* func);
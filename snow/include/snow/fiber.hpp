@@ -17,6 +17,20 @@ namespace snow {
 	ObjectPtr<Fiber> get_current_fiber();
 	ObjectPtr<Fiber> fiber_get_link(FiberConstPtr fiber);
 	CallFrame* fiber_get_current_frame(FiberConstPtr fiber);
+	
+	// Cooperative scheduling
+	typedef bool(*FiberSchedulerIdleFunc)(); // called when no fiber is runnable; blocks until one may be, returns false if there is nothing to wait for
+	typedef bool(*FiberSchedulerDoneFunc)(void* data);
+	ObjectPtr<Fiber> fiber_spawn(Value functor); // create_fiber, and queue it to run
+	void fiber_run_scheduler(); // run queued fibers until none are runnable
+	void fiber_run_scheduler_until(FiberSchedulerDoneFunc done, void* data); // or until done returns true, leaving the rest queued for the next run
+	bool fiber_scheduler_is_running();
+	void fiber_yield();
+	void fiber_park();
+	void fiber_unpark(FiberPtr fiber);
+	bool fiber_is_parked(FiberConstPtr fiber);
+	bool fiber_is_scheduled(FiberConstPtr fiber); // spawned and run by the scheduler, and so allowed to park
+	void fiber_set_scheduler_idle_handler(FiberSchedulerIdleFunc handler); // one per isolate, throws if another is set; NULL removes it
 	ObjectPtr<Class> get_fiber_class();
 }
 
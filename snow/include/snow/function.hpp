@@ -52,8 +52,21 @@ namespace snow {
 	InstanceVariableCacheLine* function_get_instance_variable_cache_lines(ObjectPtr<const Function> function);
 	AnyObjectPtr function_get_module(ObjectPtr<const Function> function);
 	
+	// Non-local exit from blocks. `break` outside of a loop ends the call that invoked the
+	// block: the block returns SN_UNWINDING, which every frame passes on until it reaches
+	// the frame that defined the block, where the call evaluates to nil. Native code that
+	// calls blocks repeatedly must stop and return SN_UNWINDING when it sees it.
+	static const VALUE SN_UNWINDING = (VALUE)0x1e; // invalid type tag, never a real value
+	VALUE call_frame_begin_unwind(const CallFrame* here);
+	VALUE call_frame_finish_unwind(const CallFrame* here);
+	// Native code that cannot pass SN_UNWINDING on to its caller turns it into an exception
+	// (`through` names the operation), or drops it when an exception is already propagating.
+	VALUE call_frame_forbid_unwind(VALUE result, const char* through);
+	void call_frame_cancel_unwind();
+	
 	// Convenience for currying `self`.
-	AnyObjectPtr create_method_proxy(Value self, Value method);
+	ObjectPtr<Class> get_bound_method_class();
+	AnyObjectPtr create_bound_method(Value self, Value method);
 }
 
 #endif /* end of include guard: FUNCTION_H_X576C5TP */
@@ -4,6 +4,7 @@
 
 #include "snow/basic.h"
 #include "snow/value.hpp"
+#include "snow/isolate.hpp"
 #include <stdlib.h>
 
 namespace snow {
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef ISOLATE_HPP_7MVKQ2RA
+#define ISOLATE_HPP_7MVKQ2RA
+
+#include "snow/basic.h"
+#include "snow/value.hpp"
+
+#include <setjmp.h>
+
+namespace snow {
+	/*
+		An Isolate is one independent Snow VM: its own heap and collector,
+		fibers and scheduler, classes and globals, loaded modules and JIT code.
+		No object in one isolate refers to an object in another, so isolates
+		running on different threads share no locks on any of their hot paths.
+		The symbol table is the only VM state that is shared between isolates
+		(symbols are process-wide ids, and interning takes a lock).
+		
+		Every thread has a current isolate, which the whole runtime API operates
+		on. snow::init creates one for the calling thread if it has none, so one
+		interpreter per thread is a matter of calling snow::init on each thread.
+		An isolate must only be used on the thread that initialized it, because
+		the collector scans that thread's stack.
+	*/
+	struct Isolate;
+	
+	Isolate* create_isolate(); // empty; make it current and call snow::init to set it up
+	Isolate* get_current_isolate();
+	Isolate* set_current_isolate(Isolate* isolate); // returns the previous one
+	
+	/*
+		Per-isolate replacement for the `static Value* root` idiom used for
+		lazily created singletons (classes, well-known objects). Each IsolateRoot
+		is given a slot number when it is constructed, and every isolate keeps
+		its own root for that slot, so the usual pattern still reads the same:
+		
+			static IsolateRoot root;
+			if (!root) root = gc_create_root(create_something());
+			return *root;
+	*/
+	class IsolateRoot {
+	public:
+		IsolateRoot();
+		Value* get() const; // NULL until set in the current isolate
+		operator Value*() const { return get(); }
+		IsolateRoot& operator=(Value* root);
+	private:
+		IsolateRoot(const IsolateRoot&) = delete;
+		IsolateRoot& operator=(const IsolateRoot&) = delete;
+		size_t _slot;
+	};
+	
+	// Arbitrary per-isolate data for extensions, keyed by the address of something the extension owns.
+	void* isolate_get_data(const void* key);
+	void isolate_set_data(const void* key, void* data);
+	
+	// From any thread: stops the isolate at its next safepoint, marks its heap, and lets it continue.
+	// The isolate frees the garbage (and runs finalizers) on its own thread as it resumes.
+	void isolate_collect_garbage(Isolate* isolate);
+	
+	/*
+		Native code that may block for a while without touching the Snow heap
+		(waiting for IO, sleeping, joining) should do so inside a SafeRegion.
+		The isolate counts as stopped while it is in one, so other threads do
+		not have to wait for it to come back to a safepoint. Values that are
+		live across the region must be on the stack or in a GC root.
+		
+			{
+				SafeRegion blocking;
+				n = ::poll(fds, nfds, timeout);
+			}
+	*/
+	class SafeRegion {
+	public:
+		SafeRegion();
+		~SafeRegion();
+	private:
+		SafeRegion(const SafeRegion&) = delete;
+		SafeRegion& operator=(const SafeRegion&) = delete;
+		Isolate* _isolate;
+		jmp_buf _registers; // callee-saved registers at entry, scanned with the stack
+	};
+}
+
+#endif /* end of include guard: ISOLATE_HPP_7MVKQ2RA */
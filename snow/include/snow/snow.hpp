@@ -28,6 +28,7 @@ namespace snow {
 	Value local_missing(CallFrame* frame, Symbol name);
 	
 	ObjectPtr<Class> get_class(Value value);
+	ObjectPtr<Class> get_immediate_class(ValueType type);
 	Value call(Value functor, Value self, size_t num_args, const Value* args);
 	Value call_with_arguments(Value functor, Value self, const Arguments& args);
 	Value call_method(Value self, Symbol method_name, size_t num_args, const Value* args);
@@ -7,6 +7,41 @@
 
 namespace snow {
 	typedef uint64_t Symbol;
+	
+	/*
+		Symbols used on hot paths in the runtime. The symbol table interns these
+		first, in this order, so their values are compile-time constants.
+		Refer to them with SN_SYM(id) instead of sym("...").
+	*/
+	#define SN_WELL_KNOWN_SYMBOLS(X) \
+		X(method_missing,   "method_missing") \
+		X(__call__,         "__call__") \
+		X(initialize,       "initialize") \
+		X(hash,             "hash") \
+		X(compare,          "<=>") \
+		X(equals,           "=") \
+		X(inspect,          "inspect") \
+		X(to_string,        "to_string") \
+		X(get,              "get") \
+		X(set,              "set") \
+		X(add,              "+") \
+		X(subtract,         "-") \
+		X(less,             "<") \
+		X(less_equal,       "<=") \
+		X(greater,          ">") \
+		X(greater_equal,    ">=") \
+		X(__module_value__, "__module_value__")
+	
+	namespace well_known_symbols {
+		enum : uint64_t {
+			_none = 0, // Symbols start at 1
+			#define SN_WELL_KNOWN_SYMBOL_ENUM(ID, NAME) ID,
+			SN_WELL_KNOWN_SYMBOLS(SN_WELL_KNOWN_SYMBOL_ENUM)
+			#undef SN_WELL_KNOWN_SYMBOL_ENUM
+			_end
+		};
+	}
+	#define SN_SYM(ID) ((snow::Symbol)snow::well_known_symbols::ID)
 
 	Symbol sym(const char* str);
 	const char* sym_to_cstr(Symbol sym);
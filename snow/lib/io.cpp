@@ -10,20 +10,319 @@
 #include "snow/str-format.hpp"
 #include "snow/exception.hpp"
 #include "snow/gc.hpp"
+#include "snow/fiber.hpp"
+#include "snow/isolate.hpp"
 
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 namespace snow_io {
 	using namespace snow;
 	
+	/*
+		EventLoop lets fibers run by the scheduler (see fiber_run_scheduler) do
+		blocking IO with straight-line code. A fiber whose non-blocking read or
+		write would block registers the descriptor with the loop and parks. When
+		no fiber is runnable, the scheduler calls run_once, which waits for
+		readiness or the nearest timer and unparks the fibers whose wait is over.
+		
+		Waits are one-shot: a descriptor is only watched while some fiber is
+		waiting on it. Fibers waiting for the same event on the same descriptor
+		are queued, and each readiness event wakes the one that has waited the
+		longest. Readiness is level-triggered, so the next one is woken on the
+		following round if the first one left something to read or room to
+		write. Each Waiter lives on the waiting fiber's stack and keeps that
+		fiber alive as a GC root while it is parked.
+		
+		Readiness is polled with epoll on Linux. Elsewhere poll() is used, which
+		costs O(number of waiting descriptors) per wait, but behaves the same.
+		
+		Outside of the scheduler there is nothing to switch to, so waits simply
+		block the thread in poll().
+		
+		Each isolate has its own loop, driven by its own scheduler.
+	*/
+	class EventLoop {
+	public:
+		enum Event {
+			Readable = 1,
+			Writable = 2,
+		};
+		
+		static EventLoop& get() { // one per isolate
+			static const char key = 0;
+			EventLoop* loop = (EventLoop*)isolate_get_data(&key);
+			if (loop == NULL) {
+				loop = new EventLoop;
+				isolate_set_data(&key, loop);
+				fiber_set_scheduler_idle_handler(EventLoop::idle_handler);
+			}
+			return *loop;
+		}
+		
+		bool wait(int fd, Event event, int64_t timeout_ms); // false if timed out
+		void sleep(int64_t ms);
+		bool run_once();
+	private:
+		struct Waiter;
+		typedef std::deque<Waiter*> WaiterQueue;
+		struct Watch {
+			WaiterQueue readers;
+			WaiterQueue writers;
+			WaiterQueue& queue(Event event) { return event == Readable ? readers : writers; }
+		};
+		typedef std::map<int, Watch> Watches;
+		typedef std::multimap<int64_t, Waiter*> Timers; // deadline (ms) => waiter
+		
+		struct Waiter {
+			EventLoop& loop;
+			Value* fiber;
+			int fd;
+			Event event;
+			bool has_timer;
+			Timers::iterator timer;
+			bool ready;
+			bool timed_out;
+			
+			Waiter(EventLoop& loop, int fd, Event event, int64_t timeout_ms);
+			~Waiter();
+			void wake();
+		};
+		
+		EventLoop();
+		static bool idle_handler() { return get().run_once(); }
+		static int64_t now_ms();
+		void update_watch(int fd);
+		int next_timeout_ms() const;
+		void fire(int fd, bool readable, bool writable, bool failed);
+		static void wake_waiters(WaiterQueue& queue, bool all);
+		void expire_timers();
+		
+		Watches _watches;
+		Timers _timers;
+		#if defined(__linux__)
+		int _epoll_fd;
+		#endif
+	};
+	
+	EventLoop::EventLoop() {
+		#if defined(__linux__)
+		_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (_epoll_fd == -1) {
+			throw_exception_with_description("EventLoop: epoll_create1(): %@", strerror(errno));
+		}
+		#endif
+	}
+	
+	int64_t EventLoop::now_ms() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	}
+	
+	EventLoop::Waiter::Waiter(EventLoop& loop, int fd, Event event, int64_t timeout_ms) : loop(loop), fd(fd), event(event), has_timer(false), ready(false), timed_out(false) {
+		fiber = gc_create_root(get_current_fiber());
+		if (timeout_ms >= 0) {
+			has_timer = true;
+			timer = loop._timers.insert(std::make_pair(now_ms() + timeout_ms, this));
+		}
+		if (fd != -1) {
+			loop._watches[fd].queue(event).push_back(this);
+			loop.update_watch(fd);
+		}
+	}
+	
+	EventLoop::Waiter::~Waiter() {
+		if (has_timer) {
+			loop._timers.erase(timer);
+		}
+		if (fd != -1) {
+			auto it = loop._watches.find(fd);
+			if (it != loop._watches.end()) {
+				WaiterQueue& queue = it->second.queue(event);
+				auto w = std::find(queue.begin(), queue.end(), this);
+				if (w != queue.end()) queue.erase(w); // still queued if it timed out
+				loop.update_watch(fd);
+			}
+		}
+		gc_free_root(fiber);
+	}
+	
+	void EventLoop::Waiter::wake() {
+		fiber_unpark(*fiber);
+	}
+	
+	void EventLoop::update_watch(int fd) {
+		auto it = _watches.find(fd);
+		if (it == _watches.end()) return;
+		const Watch& watch = it->second;
+		bool remove = watch.readers.empty() && watch.writers.empty();
+		#if defined(__linux__)
+		struct epoll_event ev = {};
+		ev.events = (watch.readers.empty() ? 0 : EPOLLIN) | (watch.writers.empty() ? 0 : EPOLLOUT);
+		ev.data.fd = fd;
+		if (remove) {
+			epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+		} else if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1 && errno == ENOENT) {
+			if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+				throw_exception_with_description("EventLoop: epoll_ctl(%@): %@", fd, strerror(errno));
+			}
+		}
+		#endif
+		if (remove) {
+			_watches.erase(it);
+		}
+	}
+	
+	bool EventLoop::wait(int fd, Event event, int64_t timeout_ms) {
+		if (!fiber_is_scheduled(get_current_fiber())) {
+			struct pollfd pfd = { fd, (short)(event == Readable ? POLLIN : POLLOUT), 0 };
+			int r;
+			{
+				SafeRegion blocking;
+				while ((r = ::poll(&pfd, 1, timeout_ms < 0 ? -1 : (int)timeout_ms)) == -1 && errno == EINTR);
+			}
+			return r != 0;
+		}
+		
+		Waiter waiter(*this, fd, event, timeout_ms);
+		while (!waiter.ready && !waiter.timed_out) {
+			fiber_park();
+		}
+		return waiter.ready;
+	}
+	
+	void EventLoop::sleep(int64_t ms) {
+		if (!fiber_is_scheduled(get_current_fiber())) {
+			struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+			SafeRegion blocking;
+			while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+			return;
+		}
+		
+		Waiter waiter(*this, -1, Readable, ms);
+		while (!waiter.timed_out) {
+			fiber_park();
+		}
+	}
+	
+	int EventLoop::next_timeout_ms() const {
+		if (_timers.empty()) return -1;
+		int64_t remaining = _timers.begin()->first - now_ms();
+		return remaining > 0 ? (int)remaining : 0;
+	}
+	
+	void EventLoop::wake_waiters(WaiterQueue& queue, bool all) {
+		while (!queue.empty()) {
+			Waiter* waiter = queue.front();
+			queue.pop_front();
+			waiter->ready = true;
+			waiter->wake();
+			if (!all) break;
+		}
+	}
+	
+	void EventLoop::fire(int fd, bool readable, bool writable, bool failed) {
+		auto it = _watches.find(fd);
+		if (it == _watches.end()) return;
+		Watch& watch = it->second;
+		// On errors, wake everyone: the next read or write reports it.
+		if (readable || failed) wake_waiters(watch.readers, failed);
+		if (writable || failed) wake_waiters(watch.writers, failed);
+		update_watch(fd);
+	}
+	
+	void EventLoop::expire_timers() {
+		int64_t now = now_ms();
+		while (!_timers.empty() && _timers.begin()->first <= now) {
+			Waiter* waiter = _timers.begin()->second;
+			_timers.erase(_timers.begin());
+			waiter->has_timer = false;
+			if (!waiter->ready) {
+				waiter->timed_out = true;
+				waiter->wake();
+			}
+		}
+	}
+	
+	bool EventLoop::run_once() {
+		if (_watches.empty() && _timers.empty()) return false;
+		
+		#if defined(__linux__)
+		static const int MAX_EVENTS = 64;
+		struct epoll_event events[MAX_EVENTS];
+		int n;
+		{
+			SafeRegion blocking;
+			n = epoll_wait(_epoll_fd, events, MAX_EVENTS, next_timeout_ms());
+		}
+		if (n == -1 && errno != EINTR) {
+			throw_exception_with_description("EventLoop: epoll_wait(): %@", strerror(errno));
+		}
+		for (int i = 0; i < n; ++i) {
+			uint32_t e = events[i].events;
+			bool failed = (e & (EPOLLERR | EPOLLHUP)) != 0;
+			fire(events[i].data.fd, (e & EPOLLIN) != 0, (e & EPOLLOUT) != 0, failed);
+		}
+		#else
+		std::vector<struct pollfd> pfds;
+		pfds.reserve(_watches.size());
+		for (auto& pair: _watches) {
+			struct pollfd pfd = { pair.first, (short)((pair.second.readers.empty() ? 0 : POLLIN) | (pair.second.writers.empty() ? 0 : POLLOUT)), 0 };
+			pfds.push_back(pfd);
+		}
+		int n;
+		{
+			SafeRegion blocking;
+			n = ::poll(pfds.data(), pfds.size(), next_timeout_ms());
+		}
+		if (n == -1 && errno != EINTR) {
+			throw_exception_with_description("EventLoop: poll(): %@", strerror(errno));
+		}
+		for (size_t i = 0; n > 0 && i < pfds.size(); ++i) {
+			short e = pfds[i].revents;
+			if (e == 0) continue;
+			bool failed = (e & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+			fire(pfds[i].fd, (e & POLLIN) != 0, (e & POLLOUT) != 0, failed);
+		}
+		#endif
+		
+		expire_timers();
+		return true;
+	}
+	
+	namespace {
+		inline bool would_block(int err) {
+			return err == EAGAIN || err == EWOULDBLOCK;
+		}
+		
+		int64_t value_to_milliseconds(Value val, const char* what) {
+			if (!is_truthy(val)) return -1; // nil, or no argument
+			if (is_integer(val)) return (int64_t)value_to_integer(val) * 1000;
+			if (is_float(val)) return (int64_t)(value_to_float(val) * 1000.0f);
+			throw_exception_with_description("%@: Expected a number of seconds, got %@.", what, value_inspect(val));
+			return -1;
+		}
+	}
+	
 	struct IO {
 		FILE* fp;
 		int fd;
+		int64_t timeout_ms; // for reads and writes that would block; -1 is no timeout
 		
-		IO() : fp(NULL), fd(-1) {}
+		IO() : fp(NULL), fd(-1), timeout_ms(-1) {}
 		~IO() { close(); }
 		
 		void init_with_file(int fd, FILE* fp) {
@@ -58,24 +357,74 @@ namespace snow_io {
 			return false;
 		}
 		
-		ssize_t write(const char* buffer, size_t len) {
+		// The buffers passed to these are never on the Snow heap, so the calls may block in a safe region.
+		ssize_t write_some(const char* buffer, size_t len) {
+			SafeRegion blocking;
 			if (has_fp()) {
-				return ::fwrite(buffer, 1, len, fp);
+				size_t n = ::fwrite(buffer, 1, len, fp);
+				if (n == 0 && ferror(fp)) {
+					clearerr(fp);
+					return -1;
+				}
+				return n;
 			} else if (has_fd()) {
 				return ::write(fd, buffer, len);
 			}
+			errno = EBADF;
 			return -1;
 		}
 		
-		ssize_t read(char* buffer, size_t max_len) {
+		ssize_t read_some(char* buffer, size_t max_len) {
+			SafeRegion blocking;
 			if (has_fp()) {
-				return ::fread(buffer, 1, max_len, fp);
+				size_t n = ::fread(buffer, 1, max_len, fp);
+				if (n == 0 && ferror(fp)) {
+					clearerr(fp);
+					return -1;
+				}
+				return n;
 			} else if (has_fd()) {
 				return ::read(fd, buffer, max_len);
 			}
+			errno = EBADF;
 			return -1;
 		}
 		
+		// On a non-blocking descriptor, these park the calling fiber while the call would block.
+		// write returns less than len only on errors and timeouts, with errno set.
+		size_t write(const char* buffer, size_t len) {
+			size_t written = 0;
+			while (written < len) {
+				ssize_t n = write_some(buffer + written, len - written);
+				if (n >= 0) {
+					written += n;
+				} else if (would_block(errno)) {
+					if (!EventLoop::get().wait(fd, EventLoop::Writable, timeout_ms)) {
+						errno = ETIMEDOUT;
+						return written;
+					}
+				} else if (errno != EINTR) {
+					return written;
+				}
+			}
+			return written;
+		}
+		
+		ssize_t read(char* buffer, size_t max_len) {
+			while (true) {
+				ssize_t n = read_some(buffer, max_len);
+				if (n >= 0) return n;
+				if (would_block(errno)) {
+					if (!EventLoop::get().wait(fd, EventLoop::Readable, timeout_ms)) {
+						errno = ETIMEDOUT;
+						return -1;
+					}
+				} else if (errno != EINTR) {
+					return -1;
+				}
+			}
+		}
+		
 		bool eof() const {
 			if (has_fp()) {
 				return feof(fp) != 0;
@@ -85,6 +434,7 @@ namespace snow_io {
 		
 		void flush() {
 			if (has_fp()) {
+				SafeRegion blocking;
 				fflush(fp);
 			}
 		}
@@ -103,7 +453,10 @@ namespace snow_io {
 				size_t len = string_size(str);
 				char buf[len];
 				len = string_copy_to(str, buf, len);
-				ssize_t n = io->write(buf, len);
+				size_t n = io->write(buf, len);
+				if (n < len) {
+					throw_exception_with_description("IO#write: %@ (wrote %@ of %@ bytes)", strerror(errno), n, len);
+				}
 				return integer_to_value(n);
 			}
 			throw_exception_with_description("Could not convert object to string: %@.", value_inspect(it));
@@ -119,6 +472,9 @@ namespace snow_io {
 			PreallocatedStringData data;
 			preallocate_string_data(data, n);
 			ssize_t nr = io->read(data.data, n);
+			if (nr < 0) {
+				throw_exception_with_description("IO#read: %@", strerror(errno));
+			}
 			data.size = nr;
 			return create_string_from_preallocated_data(data);
 		}
@@ -145,10 +501,11 @@ namespace snow_io {
 		}
 		
 		VALUE IO_puts(const CallFrame* here, VALUE self, VALUE it) {
+			static const Symbol write = sym("write"); // symbols are process-wide, so this holds in every isolate
 			Value args[] = { it };
-			call_method(self, sym("write"), 1, args);
+			call_method(self, write, 1, args);
 			args[0] = create_string_constant("\n");
-			call_method(self, sym("write"), 1, args);
+			call_method(self, write, 1, args);
 			return SN_NIL;
 		}
 		
@@ -188,8 +545,20 @@ namespace snow_io {
 			return boolean_to_value(set);
 		}
 		
+		VALUE IO_get_timeout(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<IO> io = self;
+			if (io->timeout_ms < 0) return SN_NIL;
+			return float_to_value(io->timeout_ms / 1000.0f);
+		}
+		
+		VALUE IO_set_timeout(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<IO> io = self;
+			io->timeout_ms = value_to_milliseconds(it, "IO#timeout");
+			return it;
+		}
+		
 		ObjectPtr<Class> get_io_class() {
-			static Value* root = NULL;
+			static IsolateRoot root;
 			if (!root) {
 				ObjectPtr<Class> io = create_class_for_type(sym("IO"), get_type<IO>());
 				SN_DEFINE_METHOD(io, "close", IO_close);
@@ -206,6 +575,7 @@ namespace snow_io {
 				SN_DEFINE_METHOD(io, "tell", IO_tell);
 				SN_DEFINE_PROPERTY(io, "async", IO_get_async, IO_set_async);
 				SN_DEFINE_PROPERTY(io, "nonblock", IO_get_async, IO_set_async);
+				SN_DEFINE_PROPERTY(io, "timeout", IO_get_timeout, IO_set_timeout);
 				root = gc_create_root(io);
 			}
 			return *root;
@@ -262,16 +632,18 @@ namespace snow_io {
 			}
 			
 			ObjectPtr<IO> file = create_file_for_file(fp);
-			object_set_instance_variable(file, sym("path"), filename);
+			static const Symbol path = sym("path");
+			object_set_instance_variable(file, path, filename);
 			return file;
 		}
 		
 		VALUE File_get_path(const CallFrame* here, VALUE self, VALUE it) {
-			return object_get_instance_variable(self, sym("path"));
+			static const Symbol path = sym("path");
+			return object_get_instance_variable(self, path);
 		}
 		
 		ObjectPtr<Class> get_file_class() {
-			static Value* root = NULL;
+			static IsolateRoot root;
 			if (root == NULL) {
 				ObjectPtr<Class> file = create_class(sym("File"), get_io_class());
 				SN_OBJECT_DEFINE_METHOD(file, "open", File_open);
@@ -286,7 +658,7 @@ namespace snow_io {
 		}
 		
 		VALUE get_stdout(const CallFrame* here, VALUE self, VALUE it) {
-			static Value* p = NULL;
+			static IsolateRoot p;
 			if (!p) {
 				ObjectPtr<IO> io = create_io_for_file(stdout);
 				p = gc_create_root(io);
@@ -295,7 +667,7 @@ namespace snow_io {
 		}
 		
 		VALUE get_stderr(const CallFrame* here, VALUE self, VALUE it) {
-			static Value* p = NULL;
+			static IsolateRoot p;
 			if (!p) {
 				ObjectPtr<IO> io = create_io_for_file(stderr);
 				p = gc_create_root(io);
@@ -304,13 +676,21 @@ namespace snow_io {
 		}
 		
 		VALUE get_stdin(const CallFrame* here, VALUE self, VALUE it) {
-			static Value* p = NULL;
+			static IsolateRoot p;
 			if (!p) {
 				ObjectPtr<IO> io = create_io_for_file(stdin);
 				p = gc_create_root(io);
 			}
 			return *p;
 		}
+		
+		VALUE io_sleep(const CallFrame* here, VALUE self, VALUE it) {
+			int64_t ms = value_to_milliseconds(it, "sleep");
+			if (ms > 0) {
+				EventLoop::get().sleep(ms);
+			}
+			return SN_NIL;
+		}
 	}
 	
 	VALUE module_init() {
@@ -320,6 +700,8 @@ namespace snow_io {
 		SN_OBJECT_DEFINE_PROPERTY(io, "stdin", get_stdin, NULL);
 		SN_OBJECT_DEFINE_PROPERTY(io, "IO", get_io_class, NULL);
 		SN_OBJECT_DEFINE_PROPERTY(io, "File", get_file_class, NULL);
+		SN_OBJECT_DEFINE_METHOD(io, "sleep", io_sleep);
+		EventLoop::get(); // install the scheduler idle handler
 		return io;
 	}
 }
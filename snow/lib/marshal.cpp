@@ -275,7 +275,7 @@ namespace snow {
 	
 	namespace marshal {
 		AnyObjectPtr get_module() {
-			static Value* p = NULL;
+			static IsolateRoot p;
 			if (!p) {
 				AnyObjectPtr obj = create_object(get_object_class(), 0, NULL);
 				SN_OBJECT_DEFINE_METHOD(obj, "load", Marshal_load);
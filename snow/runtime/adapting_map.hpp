@@ -92,7 +92,7 @@ namespace snow {
 	
 	struct CallValueHash {
 		size_t operator()(Value v) const {
-			Value hash = SN_CALL_METHOD(v, "hash", 0, NULL);
+			Value hash = snow::call_method(v, SN_SYM(hash), 0, NULL);
 			if (!hash.is_integer()) throw_exception_with_description("A hash method for object %@ returned a non-integer %@.", value_inspect(v), value_inspect(hash));
 			return (size_t)value_to_integer(hash);
 		}
@@ -105,7 +105,7 @@ namespace snow {
 			if (map->has_immediate_keys()) {
 				return (int64_t)((intptr_t)a.value() - (intptr_t)b.value());
 			} else {
-				Value diff = SN_CALL_METHOD(a, "<=>", 1, &b);
+				Value diff = snow::call_method(a, SN_SYM(compare), 1, &b);
 				if (!diff.is_integer()) throw_exception_with_description("A comparison method (<=>) for object %@ returned a non-integer %@.", value_inspect(a), value_inspect(diff));
 				return value_to_integer(diff);
 			}
@@ -114,7 +114,7 @@ namespace snow {
 	
 	struct CallNonImmediateValueEquals {
 		bool operator()(Value a, Value b) const {
-			Value truth = SN_CALL_METHOD(a, "=", 1, &b);
+			Value truth = snow::call_method(a, SN_SYM(equals), 1, &b);
 			return is_truthy(truth);
 		}
 	};
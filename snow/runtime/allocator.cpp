@@ -2,39 +2,52 @@
 #include "snow/gc.hpp"
 #include <sys/mman.h>
 #include <errno.h>
+#include <mutex>
 #include <new>
+#include <vector>
 
 #define DEBUG_MEMORY_CORRUPTION 0
 
 namespace snow {
-	Object* Allocator::allocate() {
-		if (free_list_.is_empty()) {
-			Block* p = find_available_block();
-			if (p == NULL) {
-				p = create_block();
+	namespace {
+		/*
+			Process-wide source of allocation blocks. Blocks are mapped
+			BLOCKS_PER_CHUNK at a time, so growing a heap rarely costs a system
+			call, and pages are only committed once an isolate bumps into them.
+		*/
+		class BlockPool {
+		public:
+			static const size_t BLOCKS_PER_CHUNK = 16;
+			
+			static BlockPool& get() {
+				static BlockPool* pool = new BlockPool; // never destroyed; heaps live until exit
+				return *pool;
 			}
-			return allocate_from_block(p);
-		} else {
-			return free_list_.pop();
-		}
-	}
-	
-	Allocator::Block* Allocator::find_available_block() {
-		for (size_t i = 0; i < blocks_.size(); ++i) {
-			if (blocks_[i]->num_available() >= SN_OBJECT_SIZE) {
-				return blocks_[i];
+			
+			byte* acquire() {
+				std::lock_guard<std::mutex> guard(_lock);
+				if (_spare.empty()) {
+					byte* chunk = (byte*)mmap(NULL, BLOCKS_PER_CHUNK * SN_ALLOCATION_BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+					if (UNLIKELY(chunk == MAP_FAILED)) {
+						perror("Memory allocation failed");
+						exit(1);
+					}
+					for (size_t i = BLOCKS_PER_CHUNK; i > 0; --i) {
+						_spare.push_back(chunk + (i - 1) * SN_ALLOCATION_BLOCK_SIZE);
+					}
+				}
+				byte* memory = _spare.back();
+				_spare.pop_back();
+				return memory;
 			}
-		}
-		return NULL;
+		private:
+			std::mutex _lock;
+			std::vector<byte*> _spare;
+		};
 	}
 	
-	Allocator::Block* Allocator::create_block() {
-		byte* memory = (byte*)mmap(NULL, SN_ALLOCATION_BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
-		if (UNLIKELY(memory == MAP_FAILED)) {
-			perror("Memory allocation failed");
-			exit(1);
-		}
-		
+	void Allocator::refill() {
+		byte* memory = BlockPool::get().acquire();
 		Block* b = new(memory) Block;
 		b->begin = memory + sizeof(Block);
 		b->begin += SN_OBJECT_SIZE - (sizeof(Block) % SN_OBJECT_SIZE); // padding
@@ -42,16 +55,6 @@ namespace snow {
 		b->end = memory + SN_ALLOCATION_BLOCK_SIZE;
 		
 		blocks_.push_front(b);
-		
-		return b;
-	}
-	
-	Allocator::GCObject* Allocator::allocate_from_block(Allocator::Block* p) {
-		ASSERT(p->num_available());
-		ASSERT(p->current <= p->end);
-		GCObject* object = (GCObject*)p->current;
-		p->current += SN_OBJECT_SIZE;
-		new(object) GCObject;
-		return object;
+		current_ = b;
 	}
-}
\ No newline at end of file
+}
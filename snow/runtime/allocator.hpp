@@ -60,6 +60,14 @@ namespace snow {
 	};
 	
 	
+	/*
+		Object allocator for one isolate's heap. Objects are allocated from the
+		free list when possible, and otherwise bumped off the current block.
+		Blocks are only ever taken whole, from a block pool shared by all
+		isolates (see allocator.cpp), so the pool's lock is taken once per
+		OBJECTS_PER_BLOCK allocations at most, and an isolate never waits for
+		another one while allocating.
+	*/
 	class Allocator {
 		struct GCObject : Object {
 			byte padding[SN_OBJECT_SIZE - sizeof(Object)];
@@ -75,6 +83,7 @@ namespace snow {
 		
 		static const size_t OBJECTS_PER_BLOCK = (SN_ALLOCATION_BLOCK_SIZE - sizeof(Block)) / SN_OBJECT_SIZE;
 		
+		Allocator() : current_(NULL) {}
 		Object* allocate();
 		void free(Object* object);
 		size_t num_blocks() const { return blocks_.size(); }
@@ -88,12 +97,29 @@ namespace snow {
 	private:
 		InPlaceFreeList<Object> free_list_;
 		std::deque<Block*> blocks_;
+		Block* current_; // the block being bump-allocated from; all other blocks are full
 		
-		Block* find_available_block();
-		Block* create_block();
+		void refill();
 		GCObject* allocate_from_block(Block* block);
 	};
 	
+	inline Object* Allocator::allocate() {
+		Object* object = free_list_.pop();
+		if (object != NULL) return object;
+		if (UNLIKELY(current_ == NULL || current_->num_available() < SN_OBJECT_SIZE)) {
+			refill();
+		}
+		return allocate_from_block(current_);
+	}
+	
+	inline Allocator::GCObject* Allocator::allocate_from_block(Allocator::Block* p) {
+		ASSERT(p->num_available() >= SN_OBJECT_SIZE);
+		GCObject* object = (GCObject*)p->current;
+		p->current += SN_OBJECT_SIZE;
+		new(object) GCObject;
+		return object;
+	}
+	
 	inline void Allocator::free(Object* object) {
 		free_list_.push(object);
 	}
@@ -79,6 +79,26 @@ namespace snow {
 		return ref;
 	}
 
+	bool array_get_storage_layout(int32_t* out_begin_offset, int32_t* out_end_offset) {
+		// The layout of std::vector is unspecified, so find the begin and end pointers
+		// by looking at an instance. Offsets are relative to the start of the object.
+		if (sizeof(Array) + sizeof(Object) > SN_CACHE_LINE_SIZE) return false; // private data not inline
+		Array probe;
+		probe.reserve(4);
+		probe.resize(2);
+		const Value* const* words = reinterpret_cast<const Value* const*>(&probe);
+		int32_t begin = -1;
+		int32_t end = -1;
+		for (int32_t i = 0; i < (int32_t)(sizeof(Array) / sizeof(void*)); ++i) {
+			if (words[i] == probe.data()) begin = i;
+			else if (words[i] == probe.data() + probe.size()) end = i;
+		}
+		if (begin < 0 || end < 0) return false;
+		*out_begin_offset = sizeof(Object) + begin * sizeof(void*);
+		*out_end_offset = sizeof(Object) + end * sizeof(void*);
+		return true;
+	}
+
 	void array_reserve(ArrayPtr array, uint32_t new_size) {
 		array->reserve(new_size);
 	}
@@ -157,7 +177,7 @@ namespace snow {
 			if (array == NULL) return NULL;
 			for (size_t i = 0; i < array->size(); ++i) {
 				Value args[] = { (*array)[i] };
-				call(it, NULL, 1, args);
+				if (call(it, NULL, 1, args) == SN_UNWINDING) return SN_UNWINDING;
 			}
 			return SN_NIL;
 		}
@@ -177,7 +197,7 @@ namespace snow {
 	}
 
 	ObjectPtr<Class> get_array_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Array"), get_type<Array>());
 			SN_DEFINE_METHOD(cls, "initialize", bindings::array_initialize);
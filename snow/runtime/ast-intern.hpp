@@ -97,6 +97,7 @@ namespace snow {
 	inline ASTNode* AST::identifier(const LexerLocation& loc, Symbol sym) {
 		ASTNode* n = create(loc, ASTNodeTypeIdentifier);
 		n->identifier.name = sym;
+		n->identifier.id_type = NULL;
 		return n;
 	}
 	
@@ -41,6 +41,10 @@ namespace snow {
 					this->free(node->return_expr.value);
 					break;
 				}
+				case ASTNodeTypeIdentifier: {
+					this->free(node->identifier.id_type);
+					break;
+				}
 				case ASTNodeTypeAssign: {
 					this->free(node->assign.target);
 					this->free(node->assign.value);
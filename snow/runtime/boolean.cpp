@@ -18,7 +18,7 @@ namespace snow {
 	
 	
 	ObjectPtr<Class> get_boolean_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Boolean"), NULL);
 			SN_DEFINE_METHOD(cls, "inspect", bindings::boolean_inspect);
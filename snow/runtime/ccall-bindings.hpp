@@ -5,8 +5,10 @@
 #include "snow/snow.hpp"
 #include "snow/class.hpp"
 #include "snow/array.hpp"
+#include "snow/map.hpp"
 #include "snow/object.hpp"
 #include "snow/function.hpp"
+#include "snow/exception.hpp"
 #include "inline-cache.hpp"
 #include "function-internal.hpp"
 #include "internal.h"
@@ -106,18 +108,41 @@ namespace snow {
 			return snow::local_missing(here, name);
 		}
 		
-		Object* create_method_proxy(VALUE object, VALUE method) {
-			return snow::create_method_proxy(object, method);
+		Object* create_bound_method(VALUE object, VALUE method) {
+			return snow::create_bound_method(object, method);
 		}
 		
 		Object* create_array_with_size(uint32_t size) {
 			return snow::create_array_with_size(size);
 		}
 		
+		VALUE map_get(VALUE map, VALUE key) {
+			return snow::map_get(map, key);
+		}
+		
+		VALUE map_set(VALUE map, VALUE key, VALUE val) {
+			return snow::map_set(map, key, val);
+		}
+		
+		VALUE call_frame_begin_unwind(const CallFrame* here) {
+			return snow::call_frame_begin_unwind(here);
+		}
+		
+		VALUE call_frame_finish_unwind(const CallFrame* here) {
+			return snow::call_frame_finish_unwind(here);
+		}
+		
 		Value* call_frame_get_locals(const CallFrame* here) {
 			return here->locals;
 		}
 		
+		void type_hint_mismatch(VALUE val, int32_t expected, Symbol name) {
+			const char* expected_name = class_get_name(get_immediate_class((ValueType)expected));
+			if (val == NULL)
+				throw_exception_with_description("'%@' is declared as %@, but was given nothing.", sym_to_cstr(name), expected_name);
+			throw_exception_with_description("'%@' is declared as %@, but was given %@.", sym_to_cstr(name), expected_name, value_inspect(val));
+		}
+		
 		int32_t object_get_or_create_index_of_instance_variable(VALUE obj, Symbol name) {
 			return snow::object_get_or_create_index_of_instance_variable(obj, name);
 		}
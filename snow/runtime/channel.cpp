@@ -0,0 +1,359 @@
+#include "snow/channel.hpp"
+#include "internal.h"
+#include "snow/array.hpp"
+#include "snow/boolean.hpp"
+#include "snow/class.hpp"
+#include "snow/exception.hpp"
+#include "snow/fiber.hpp"
+#include "snow/function.hpp"
+#include "snow/gc.hpp"
+#include "snow/numeric.hpp"
+#include "snow/snow.hpp"
+#include "snow/str.hpp"
+#include "snow/type.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+/*
+	Channels pass values between the fibers of one isolate; they are not
+	shared across isolates, and so never between threads. Buffered values are kept in a ring
+	buffer that grows by doubling (unbounded channels) or is capped at the
+	channel's capacity (bounded channels). A capacity of 0 makes an unbuffered
+	channel, where every send waits for a receiver to take the value.
+	
+	A fiber that cannot proceed registers a ChannelWait on the channel and
+	parks, and whoever completes the operation on the other end unparks it. A
+	select registers one ChannelWait per channel, all sharing one ParkedFiber,
+	and the first channel to complete any of them wins; the others are skipped
+	as stale and removed when the select returns.
+	
+	The ParkedFiber lives on the blocked fiber's stack and keeps the fiber
+	alive as a GC root while it is parked. Values waiting to be sent are
+	reported by the channel's gc_each_root.
+*/
+
+namespace snow {
+	struct Channel;
+	struct ParkedFiber;
+	
+	struct ChannelWait {
+		Channel* channel;
+		ParkedFiber* parked;
+		size_t index; // in the select
+		Value value;  // to send
+	};
+	
+	struct ParkedFiber {
+		Value* fiber;
+		std::vector<ChannelWait> waits; // never reallocated once registered
+		bool done;
+		bool closed;
+		size_t index; // of the wait that completed
+		Value value;  // received
+		
+		explicit ParkedFiber(size_t num_waits);
+		~ParkedFiber();
+		void wait_on(Channel* channel, size_t index, bool send, Value value);
+		void complete(const ChannelWait* wait, Value received, bool closed_while_waiting);
+	};
+	
+	struct Channel {
+		std::vector<Value> ring; // size is zero or a power of two
+		uint32_t head;
+		uint32_t count;
+		int32_t capacity; // SN_CHANNEL_UNBOUNDED, or the maximum count
+		bool is_closed;
+		std::deque<ChannelWait*> senders;
+		std::deque<ChannelWait*> receivers;
+		
+		Channel() : head(0), count(0), capacity(SN_CHANNEL_UNBOUNDED), is_closed(false) {}
+		
+		bool is_full() const {
+			return capacity != SN_CHANNEL_UNBOUNDED && count >= (uint32_t)capacity;
+		}
+		
+		void push(Value val) {
+			if (count == ring.size()) grow();
+			ring[(head + count) & (ring.size() - 1)] = val;
+			++count;
+		}
+		
+		Value pop() {
+			ASSERT(count > 0);
+			Value val = ring[head];
+			ring[head] = NULL;
+			head = (head + 1) & (ring.size() - 1);
+			--count;
+			return val;
+		}
+		
+		void grow() {
+			size_t new_size = ring.empty() ? 8 : ring.size() * 2;
+			std::vector<Value> grown(new_size, Value());
+			for (uint32_t i = 0; i < count; ++i) {
+				grown[i] = ring[(head + i) & (ring.size() - 1)];
+			}
+			ring.swap(grown);
+			head = 0;
+		}
+		
+		static ChannelWait* next_waiter(std::deque<ChannelWait*>& queue) {
+			while (!queue.empty()) {
+				ChannelWait* wait = queue.front();
+				queue.pop_front();
+				if (!wait->parked->done) return wait; // otherwise completed elsewhere by a select
+			}
+			return NULL;
+		}
+		
+		static void remove_waiter(std::deque<ChannelWait*>& queue, ChannelWait* wait) {
+			auto it = std::find(queue.begin(), queue.end(), wait);
+			if (it != queue.end()) queue.erase(it);
+		}
+	};
+	
+	namespace {
+		ParkedFiber::ParkedFiber(size_t num_waits) : fiber(gc_create_root(get_current_fiber())), done(false), closed(false), index(0), value(NULL) {
+			waits.reserve(num_waits);
+		}
+		
+		ParkedFiber::~ParkedFiber() {
+			for (ChannelWait& wait: waits) {
+				Channel::remove_waiter(wait.channel->senders, &wait);
+				Channel::remove_waiter(wait.channel->receivers, &wait);
+			}
+			gc_free_root(fiber);
+		}
+		
+		void ParkedFiber::wait_on(Channel* channel, size_t index, bool send, Value value) {
+			ASSERT(waits.size() < waits.capacity());
+			waits.push_back((ChannelWait){ channel, this, index, value });
+			(send ? channel->senders : channel->receivers).push_back(&waits.back());
+		}
+		
+		void ParkedFiber::complete(const ChannelWait* wait, Value received, bool closed_while_waiting) {
+			ASSERT(!done);
+			done = true;
+			closed = closed_while_waiting;
+			index = wait->index;
+			value = received;
+			fiber_unpark(*fiber);
+		}
+		
+		void check_can_block(const char* operation) {
+			if (!fiber_is_scheduled(get_current_fiber())) {
+				throw_exception_with_description("%@: Would block, but the current fiber is not run by the fiber scheduler.", operation);
+			}
+		}
+		
+		void park_until_done(ParkedFiber& parked) {
+			while (!parked.done) {
+				fiber_park();
+			}
+		}
+		
+		bool try_receive(Channel* channel, Value* out_value) {
+			if (channel->count > 0) {
+				*out_value = channel->pop();
+				// Room was made, so let a blocked sender in.
+				ChannelWait* sender = Channel::next_waiter(channel->senders);
+				if (sender != NULL) {
+					channel->push(sender->value);
+					sender->parked->complete(sender, NULL, false);
+				}
+				return true;
+			}
+			ChannelWait* sender = Channel::next_waiter(channel->senders);
+			if (sender != NULL) {
+				// Unbuffered, take the value directly.
+				*out_value = sender->value;
+				sender->parked->complete(sender, NULL, false);
+				return true;
+			}
+			return false;
+		}
+	}
+	
+	static void channel_gc_each_root(void* priv, GCCallback callback) {
+		auto channel = static_cast<Channel*>(priv);
+		for (uint32_t i = 0; i < channel->count; ++i) {
+			callback(channel->ring[(channel->head + i) & (channel->ring.size() - 1)]);
+		}
+		for (ChannelWait* wait: channel->senders) {
+			callback(wait->value);
+		}
+	}
+	
+	SN_REGISTER_TYPE(Channel, ((Type){ .data_size = sizeof(Channel), .initialize = snow::construct<Channel>, .finalize = snow::destruct<Channel>, .copy = NULL, .gc_each_root = channel_gc_each_root}))
+	
+	ObjectPtr<Channel> create_channel(int32_t capacity) {
+		ObjectPtr<Channel> channel = create_object_without_initialize(get_channel_class());
+		channel->capacity = capacity;
+		return channel;
+	}
+	
+	void channel_send(ChannelPtr channel, Value value) {
+		if (channel->is_closed)
+			throw_exception_with_description("Channel#send: Channel is closed.");
+		
+		ChannelWait* receiver = Channel::next_waiter(channel->receivers);
+		if (receiver != NULL) {
+			receiver->parked->complete(receiver, value, false);
+			return;
+		}
+		if (!channel->is_full()) {
+			channel->push(value);
+			return;
+		}
+		
+		check_can_block("Channel#send");
+		ParkedFiber parked(1);
+		parked.wait_on(&*channel, 0, true, value);
+		park_until_done(parked);
+		if (parked.closed)
+			throw_exception_with_description("Channel#send: Channel was closed while sending.");
+	}
+	
+	Value channel_receive(ChannelPtr channel, bool* out_closed) {
+		Value value;
+		if (out_closed) *out_closed = false;
+		if (try_receive(&*channel, &value)) return value;
+		if (channel->is_closed) {
+			if (out_closed) *out_closed = true;
+			return SN_NIL;
+		}
+		
+		check_can_block("Channel#receive");
+		ParkedFiber parked(1);
+		parked.wait_on(&*channel, 0, false, NULL);
+		park_until_done(parked);
+		if (parked.closed) {
+			if (out_closed) *out_closed = true;
+			return SN_NIL;
+		}
+		return parked.value;
+	}
+	
+	bool channel_try_receive(ChannelPtr channel, Value* out_value) {
+		return try_receive(&*channel, out_value);
+	}
+	
+	void channel_close(ChannelPtr channel) {
+		if (channel->is_closed) return;
+		channel->is_closed = true;
+		while (ChannelWait* receiver = Channel::next_waiter(channel->receivers)) {
+			receiver->parked->complete(receiver, SN_NIL, true);
+		}
+		while (ChannelWait* sender = Channel::next_waiter(channel->senders)) {
+			sender->parked->complete(sender, NULL, true);
+		}
+	}
+	
+	bool channel_is_closed(ChannelConstPtr channel) {
+		return channel->is_closed;
+	}
+	
+	size_t channel_size(ChannelConstPtr channel) {
+		return channel->count;
+	}
+	
+	size_t channel_select(const ChannelPtr* channels, size_t num_channels, Value* out_value, bool* out_closed) {
+		ASSERT(num_channels > 0);
+		if (out_closed) *out_closed = false;
+		for (size_t i = 0; i < num_channels; ++i) {
+			if (try_receive(&*channels[i], out_value)) return i;
+		}
+		for (size_t i = 0; i < num_channels; ++i) {
+			if (channels[i]->is_closed) {
+				*out_value = SN_NIL;
+				if (out_closed) *out_closed = true;
+				return i;
+			}
+		}
+		
+		check_can_block("select");
+		ParkedFiber parked(num_channels);
+		for (size_t i = 0; i < num_channels; ++i) {
+			parked.wait_on(&*channels[i], i, false, NULL);
+		}
+		park_until_done(parked);
+		*out_value = parked.closed ? Value(SN_NIL) : parked.value;
+		if (out_closed) *out_closed = parked.closed;
+		return parked.index;
+	}
+	
+	namespace bindings {
+		static VALUE channel_initialize(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<Channel> channel = self;
+			if (it == NULL || it == SN_NIL) {
+				channel->capacity = SN_CHANNEL_UNBOUNDED;
+			} else if (is_integer(it) && value_to_integer(it) >= 0) {
+				channel->capacity = value_to_integer(it);
+			} else {
+				throw_exception_with_description("Channel#initialize: Expected capacity to be nil or a non-negative integer, got %@.", value_inspect(it));
+			}
+			return self;
+		}
+		
+		static VALUE channel_inspect(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<Channel> channel = self;
+			if (channel->capacity == SN_CHANNEL_UNBOUNDED)
+				return format_string("[Channel@%@ size:%@%@]", format::pointer(channel), (int64_t)channel->count, channel->is_closed ? " closed" : "");
+			return format_string("[Channel@%@ size:%@ capacity:%@%@]", format::pointer(channel), (int64_t)channel->count, (int64_t)channel->capacity, channel->is_closed ? " closed" : "");
+		}
+		
+		static VALUE channel_send(const CallFrame* here, VALUE self, VALUE it) {
+			snow::channel_send(self, it);
+			return self;
+		}
+		
+		static VALUE channel_receive(const CallFrame* here, VALUE self, VALUE it) {
+			return snow::channel_receive(self);
+		}
+		
+		static VALUE channel_close(const CallFrame* here, VALUE self, VALUE it) {
+			snow::channel_close(self);
+			return self;
+		}
+		
+		static VALUE channel_is_closed(const CallFrame* here, VALUE self, VALUE it) {
+			return boolean_to_value(snow::channel_is_closed(self));
+		}
+		
+		static VALUE channel_get_size(const CallFrame* here, VALUE self, VALUE it) {
+			return integer_to_value((int)snow::channel_size(self));
+		}
+		
+		static VALUE channel_each(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<Channel> channel = self;
+			while (true) {
+				bool closed;
+				Value value = snow::channel_receive(channel, &closed);
+				if (closed) break;
+				if (call(it, NULL, 1, &value) == SN_UNWINDING) return SN_UNWINDING;
+			}
+			return SN_NIL;
+		}
+	}
+	
+	ObjectPtr<Class> get_channel_class() {
+		static IsolateRoot root;
+		if (!root) {
+			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Channel"), get_type<Channel>());
+			SN_DEFINE_METHOD(cls, "initialize", bindings::channel_initialize);
+			SN_DEFINE_METHOD(cls, "inspect", bindings::channel_inspect);
+			SN_DEFINE_METHOD(cls, "to_string", bindings::channel_inspect);
+			SN_DEFINE_METHOD(cls, "send", bindings::channel_send);
+			SN_DEFINE_METHOD(cls, "<<", bindings::channel_send);
+			SN_DEFINE_METHOD(cls, "receive", bindings::channel_receive);
+			SN_DEFINE_METHOD(cls, "close", bindings::channel_close);
+			SN_DEFINE_METHOD(cls, "each", bindings::channel_each);
+			SN_DEFINE_PROPERTY(cls, "closed?", bindings::channel_is_closed, NULL);
+			SN_DEFINE_PROPERTY(cls, "size", bindings::channel_get_size, NULL);
+			root = gc_create_root(cls);
+		}
+		return *root;
+	}
+}
@@ -9,6 +9,7 @@
 #include "snow/objectptr.hpp"
 #include "internal.h"
 #include "codemanager.hpp"
+#include "isolate-internal.hpp"
 
 #include <algorithm>
 #include <vector>
@@ -22,8 +23,9 @@ namespace snow {
 		std::vector<Symbol> instance_variables;
 		Value initialize;
 		bool is_meta;
+		uint32_t methods_version; // incremented whenever a method or property is added
 		
-		Class() : name(0), instance_type(NULL), is_meta(false) {}
+		Class() : name(0), instance_type(NULL), is_meta(false), methods_version(0) {}
 		~Class() {
 			for (size_t i = 0; i < methods.size(); ++i) {
 				if (methods[i].type == MethodTypeProperty) {
@@ -49,6 +51,55 @@ namespace snow {
 	
 	SN_REGISTER_CPP_TYPE(Class, class_gc_each_root)
 	
+	namespace {
+		/*
+			Global (class, name) -> method cache in front of class_lookup_method,
+			so inline cache misses and megamorphic call sites do not have to walk
+			the class hierarchy. Results for method_missing are cached as well.
+			
+			Entries are invalidated in bulk by bumping the epoch. That happens
+			whenever a method is defined or a superclass changes, and on every GC
+			(cached results are raw VALUEs and classes may be freed and their
+			addresses reused).
+			
+			Each isolate has its own cache, since classes belong to one isolate.
+		*/
+		struct GlobalMethodCacheEntry {
+			const Class* cls;
+			Symbol name;
+			uint64_t epoch;
+			MethodQueryResult result;
+		};
+		
+		static const size_t GLOBAL_METHOD_CACHE_SIZE = 4096; // must be a power of two
+	}
+	
+	struct MethodCache {
+		GlobalMethodCacheEntry entries[GLOBAL_METHOD_CACHE_SIZE];
+		uint64_t epoch;
+		
+		MethodCache() : epoch(1) { // zeroed entries are invalid
+			memset(entries, 0, sizeof(entries));
+		}
+	};
+	
+	namespace {
+		inline MethodCache& global_method_cache() {
+			Isolate& isolate = current_isolate();
+			if (UNLIKELY(!isolate.method_cache)) isolate.method_cache = new MethodCache;
+			return *isolate.method_cache;
+		}
+		
+		inline GlobalMethodCacheEntry& global_method_cache_entry(MethodCache& cache, const Class* cls, Symbol name) {
+			uintptr_t h = ((uintptr_t)cls >> 4) ^ (name * 0x9e3779b97f4a7c15ULL);
+			return cache.entries[(h ^ (h >> 32)) & (GLOBAL_METHOD_CACHE_SIZE - 1)];
+		}
+	}
+	
+	void class_invalidate_method_cache() {
+		++global_method_cache().epoch;
+	}
+	
 	struct MethodLessThan {
 		bool operator()(const Method& a, const Method& b) {
 			return a.name < b.name;
@@ -63,6 +114,7 @@ namespace snow {
 			ObjectPtr<Class> super = it;
 			if (super != NULL) {
 				cls->super = super;
+				class_invalidate_method_cache();
 				cls->instance_type = super->instance_type;
 				cls->instance_variables = super->instance_variables;
 			} else if (is_truthy(it)) {
@@ -130,6 +182,25 @@ namespace snow {
 		return cls->is_meta;
 	}
 	
+	ClassConstPtr class_get_super(ClassConstPtr cls) {
+		ObjectPtr<const Class> object_class = get_object_class();
+		if (cls == object_class) return NULL;
+		return cls->super != NULL ? ClassConstPtr(cls->super) : object_class;
+	}
+	
+	ClassConstPtr class_get_method_owner(ClassConstPtr cls, Symbol name) {
+		Method key = { .name = name, .type = MethodTypeNone };
+		for (ObjectPtr<const Class> c = cls; c != NULL; c = class_get_super(c)) {
+			if (name == SN_SYM(initialize) && c->initialize) return c;
+			if (std::binary_search(c->methods.begin(), c->methods.end(), key, MethodLessThan())) return c;
+		}
+		return NULL;
+	}
+	
+	const uint32_t* class_get_methods_version(ClassConstPtr cls) {
+		return &cls->methods_version;
+	}
+	
 	int32_t class_get_index_of_instance_variable(ClassConstPtr cls, Symbol name) {
 		for (size_t i = 0; i < cls->instance_variables.size(); ++i) {
 			if (cls->instance_variables[i] == name) return (int32_t)i;
@@ -150,12 +221,11 @@ namespace snow {
 	
 	static bool class_lookup_method(ClassConstPtr cls, Symbol name, Method* out_method) {
 		ObjectPtr<const Class> object_class = get_object_class();
-		static const Symbol init_sym = snow::sym("initialize");
 		Method key = { .name = name, .type = MethodTypeNone };
 		ObjectPtr<const Class> c = cls;
 		while (c != NULL) {
 			// Check for 'initialize'
-			if (name == init_sym && c->initialize) {
+			if (name == SN_SYM(initialize) && c->initialize) {
 				out_method->type = MethodTypeFunction;
 				out_method->function = c->initialize;
 				return true;
@@ -182,21 +252,31 @@ namespace snow {
 	}
 	
 	bool class_lookup_method(ClassConstPtr cls, Symbol name, MethodQueryResult* out_method) {
+		const Class* key = cls;
+		MethodCache& cache = global_method_cache();
+		GlobalMethodCacheEntry& entry = global_method_cache_entry(cache, key, name);
+		if (LIKELY(entry.epoch == cache.epoch && entry.cls == key && entry.name == name)) {
+			*out_method = entry.result;
+			return true;
+		}
+		
 		Method m;
 		if (class_lookup_method(cls, name, &m)) {
 			out_method->type = m.type;
 			out_method->result = m.type == MethodTypeFunction ? m.function : m.property->getter;
-			return true;
-		}
-		
-		if (class_lookup_method(cls, sym("method_missing"), &m)) {
+		} else if (class_lookup_method(cls, SN_SYM(method_missing), &m)) {
 			out_method->type = MethodTypeMissing;
 			out_method->result = m.function;
-			return true;
+		} else {
+			TRAP(); // method_missing not defined in Object.
+			return false;
 		}
 		
-		TRAP(); // method_missing not defined in Object.
-		return false;
+		entry.cls = key;
+		entry.name = name;
+		entry.epoch = cache.epoch;
+		entry.result = *out_method;
+		return true;
 	}
 	
 	bool class_lookup_property_setter(ClassConstPtr cls, Symbol name, MethodQueryResult* out_method) {
@@ -216,8 +296,7 @@ namespace snow {
 	}
 	
 	static bool class_define_method_or_property(ClassPtr cls, const Method& key) {
-		static const Symbol init_sym = snow::sym("initialize");
-		if (key.name == init_sym) {
+		if (key.name == SN_SYM(initialize)) {
 			if (key.type == MethodTypeProperty)
 				throw_exception_with_description("Cannot define a property by the name 'initialize'.");
 			cls->initialize = key.function;
@@ -226,6 +305,8 @@ namespace snow {
 		std::vector<Method>::iterator x = std::lower_bound(cls->methods.begin(), cls->methods.end(), key, MethodLessThan());
 		if (x == cls->methods.end() || x->name != key.name) {
 			cls->methods.insert(x, key);
+			++cls->methods_version;
+			class_invalidate_method_cache();
 			return true;
 		}
 		return false;
@@ -253,7 +334,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_class_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			// bootstrapping
 			AnyObjectPtr class_class = gc_allocate_object(get_type<Class>());
@@ -316,7 +397,7 @@ namespace snow {
 		// TODO: Consider how to call superclass initializers
 		Value initialize = class_get_initialize(get_class(object));
 		if (initialize != NULL) {
-			call_with_arguments(initialize, object, args);
+			call_frame_forbid_unwind(call_with_arguments(initialize, object, args), "initialize");
 		}
 	}
 	
@@ -0,0 +1,72 @@
+#include "codeheap.hpp"
+#include "internal.h"
+
+#include <sys/mman.h>
+
+namespace snow {
+	namespace {
+		inline size_t round_up(size_t n, size_t multiple) {
+			return (n + multiple - 1) & ~(multiple - 1);
+		}
+		
+		inline void protect_pages(byte* memory, size_t size, int prot) {
+			uintptr_t begin = (uintptr_t)memory & ~(SN_MEMORY_PAGE_SIZE - 1);
+			uintptr_t end = round_up((uintptr_t)memory + size, SN_MEMORY_PAGE_SIZE);
+			mprotect((void*)begin, end - begin, prot);
+		}
+	}
+	
+	CodeHeap::~CodeHeap() {
+		for (const Region& region: _regions) {
+			munmap(region.memory, region.size);
+		}
+	}
+	
+	byte* CodeHeap::allocate(size_t size) {
+		size = round_up(size, ALIGNMENT);
+		
+		// First fit, lowest address first, so live code stays packed together.
+		for (auto it = _free.begin(); it != _free.end(); ++it) {
+			if (it->second >= size) {
+				byte* memory = it->first;
+				size_t remaining = it->second - size;
+				_free.erase(it);
+				if (remaining) {
+					_free[memory + size] = remaining;
+				}
+				return memory;
+			}
+		}
+		
+		Region region;
+		region.size = round_up(size, REGION_SIZE);
+		region.memory = (byte*)mmap(NULL, region.size, PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANON, -1, 0);
+		if (region.memory == MAP_FAILED) {
+			return NULL;
+		}
+		_regions.push_back(region);
+		if (region.size > size) {
+			_free[region.memory + size] = region.size - size;
+		}
+		return region.memory;
+	}
+	
+	void CodeHeap::begin_write(byte* memory, size_t size) {
+		protect_pages(memory, size, PROT_READ|PROT_WRITE);
+	}
+	
+	void CodeHeap::end_write(byte* memory, size_t size) {
+		protect_pages(memory, size, PROT_READ|PROT_EXEC);
+	}
+	
+	bool CodeHeap::contains(const void* p) const {
+		return find_region(p) != NULL;
+	}
+	
+	const CodeHeap::Region* CodeHeap::find_region(const void* p) const {
+		for (const Region& region: _regions) {
+			if (p >= region.memory && p < region.memory + region.size) return &region;
+		}
+		return NULL;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef CODEHEAP_HPP_T2WQ8MZD
+#define CODEHEAP_HPP_T2WQ8MZD
+
+#include "snow/basic.h"
+
+#include <vector>
+#include <map>
+
+namespace snow {
+	/*
+		CodeHeap hands out executable memory for JIT code from a small number of
+		large regions, instead of one mapping per module. Code compiled together
+		(such as consecutive lines in the REPL) ends up on the same pages.
+		
+		Memory is never writable and executable at the same time: regions are
+		mapped R+X, and begin_write/end_write flip the pages of one allocation to
+		R+W while it is being filled in. Neighbouring code on the same pages is
+		not executable in that window. That is fine because each isolate has its
+		own heap, which only the isolate's thread compiles into and runs.
+		
+		Code is never freed: functions created by a module point into its code,
+		and may outlive the module, so code lives as long as the isolate.
+	*/
+	class CodeHeap {
+	public:
+		static const size_t REGION_SIZE = 256 * SN_MEMORY_PAGE_SIZE; // 1 MiB
+		static const size_t ALIGNMENT = 16;
+		
+		CodeHeap() {}
+		~CodeHeap();
+		
+		byte* allocate(size_t size);
+		void begin_write(byte* memory, size_t size);
+		void end_write(byte* memory, size_t size);
+		bool contains(const void* p) const;
+		
+		size_t region_count() const { return _regions.size(); }
+	private:
+		struct Region {
+			byte* memory;
+			size_t size;
+		};
+		typedef std::map<byte*, size_t> FreeList; // start => size; the unused ends of regions
+		
+		const Region* find_region(const void* p) const;
+		
+		std::vector<Region> _regions;
+		FreeList _free;
+	};
+}
+
+#endif /* end of include guard: CODEHEAP_HPP_T2WQ8MZD */
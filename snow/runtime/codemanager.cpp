@@ -1,20 +1,15 @@
 #include "codemanager.hpp"
 #include "x86-64/codegen.hpp"
 #include "x86-64/cconv.hpp"
+#include "perfmap.hpp"
+#include "isolate-internal.hpp"
 
 #include <vector>
 #include <memory>
 #include <algorithm>
-#include <sys/mman.h>
 #include <libunwind.h>
 
 namespace snow {
-	CodeModule::~CodeModule() {
-		if (memory) {
-			munmap(memory, size);
-		}
-	}
-
 	CodeModule* CodeManager::compile_ast(const ASTBase* ast, const std::string& source, const std::string& path)
 	{
 		x86_64::CodegenSettings settings = {
@@ -29,53 +24,76 @@ namespace snow {
 			mod->source_file.source = source;
 			mod->size = codegen.compiled_size();
 			
-			mod->memory = (byte*)mmap(NULL, mod->size, PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+			mod->memory = _code_heap.allocate(mod->size);
+			if (mod->memory == NULL) {
+				return NULL;
+			}
+			_code_heap.begin_write(mod->memory, mod->size);
 			codegen.materialize_in(*mod);
-			mprotect(mod->memory, mod->size, PROT_WRITE|PROT_EXEC);
+			_code_heap.end_write(mod->memory, mod->size);
 			mod->entry = (const FunctionDescriptor*)(mod->memory + codegen.get_offset_for_entry_descriptor());
+			if (PerfMap* perf_map = PerfMap::get()) {
+				perf_map->write_module(*mod);
+			}
 
 			CodeModule* ret = mod.get();
+			CodeRange range;
+			range.end = (uintptr_t)(ret->memory + ret->size);
+			range.module = ret;
+			range.module_name = 0;
+			range.function_name = 0;
+			_address_index[(uintptr_t)ret->memory] = range;
 			_modules.push_back(std::move(mod));
 			return ret;
 		}
 		return NULL;
 	}
 	
+	bool CodeManager::enable_perf_map(bool with_jitdump) {
+		if (_wrote_perf_map) return true;
+		if (!PerfMap::enable(with_jitdump)) {
+			return false;
+		}
+		// Modules this isolate compiled before now (such as the prelude) are written out as well.
+		for (const std::unique_ptr<CodeModule>& module: _modules) {
+			PerfMap::get()->write_module(*module);
+		}
+		_wrote_perf_map = true;
+		return true;
+	}
+	
 	CodeManager* CodeManager::get() {
-		static CodeManager* manager = NULL;
-		if (!manager) manager = new CodeManager;
-		return manager;
+		Isolate& isolate = current_isolate();
+		if (!isolate.code_manager) isolate.code_manager = new CodeManager;
+		return isolate.code_manager;
 	}
 	
 	bool CodeManager::find_source_location_from_instruction_pointer(void* ip, const SourceFile*& out_file, const SourceLocation*& out_location) {
-		byte* p = (byte*)ip;
-		for (const std::unique_ptr<CodeModule>& module: _modules) {
-			byte* end = module->memory + module->size;
-			if (p >= module->memory && p < end) {
-				size_t offset = p - module->memory;
-				
-				struct CompareOffsets {
-					bool operator()(const SourceLocation& a, const SourceLocation& b) {
-						return a.code_offset < b.code_offset;
-					}
-					bool operator()(const SourceLocation& a, uint32_t offset) {
-						return a.code_offset < offset;
-					}
-				};
-				auto begin = module->locations.begin();
-				auto end   = module->locations.end();
-				if (begin != end) {
-					auto location = std::lower_bound(begin, end, offset, CompareOffsets());
-					if (location != begin) {
-						// lower_bound finds the first element that is *not* less than offset, which is exactly one past the one we need.
-						--location;
-					}
-					out_file = &module->source_file;
-					out_location = &*location;
-					return true;
-				}
-				return false;
+		const CodeModule* module = find_module_containing(ip);
+		if (module == NULL) {
+			return false;
+		}
+		
+		struct CompareOffsets {
+			bool operator()(const SourceLocation& a, const SourceLocation& b) {
+				return a.code_offset < b.code_offset;
+			}
+			bool operator()(const SourceLocation& a, uint32_t offset) {
+				return a.code_offset < offset;
+			}
+		};
+		size_t offset = (byte*)ip - module->memory;
+		auto begin = module->locations.begin();
+		auto end   = module->locations.end();
+		if (begin != end) {
+			auto location = std::lower_bound(begin, end, offset, CompareOffsets());
+			if (location != begin) {
+				// lower_bound finds the first element that is *not* less than offset, which is exactly one past the one we need.
+				--location;
 			}
+			out_file = &module->source_file;
+			out_location = &*location;
+			return true;
 		}
 		return false;
 	}
@@ -7,6 +7,7 @@
 #include "snow/symbol.hpp"
 
 #include "function-internal.hpp"
+#include "codeheap.hpp"
 
 #include <vector>
 #include <string>
@@ -16,10 +17,18 @@
 struct unw_cursor_t;
 
 namespace snow {
+	class PerfMap;
+	
 	struct SourceLocation : LexerLocation {
 		uint32_t code_offset;
 	};
 	
+	struct CodeFunction {
+		uint32_t code_offset; // relative to CodeModule::memory
+		uint32_t code_length;
+		Symbol name;          // 0 for anonymous functions
+	};
+	
 	struct SourceFile {
 		std::string path;
 		std::string source;
@@ -29,12 +38,12 @@ namespace snow {
 		typedef std::vector<SourceLocation> LocationList; // sorted by code_offset
 		SourceFile source_file;
 		LocationList locations;
+		std::vector<CodeFunction> functions; // sorted by code_offset
 		byte* memory;
 		size_t size;
 		const FunctionDescriptor* entry;
 		
-		CodeModule() : memory(nullptr), size(0) {}
-		~CodeModule();
+		CodeModule() : memory(nullptr), size(0) {} // the memory belongs to the CodeHeap and is never freed
 	};
 	
 	class CodeManager {
@@ -44,6 +53,7 @@ namespace snow {
 		static CodeManager* get();
 		
 		CodeModule* compile_ast(const ASTBase* ast, const std::string& source, const std::string& path);
+		bool enable_perf_map(bool with_jitdump);
 		ModuleInitFunc load_module(const char* path);
 		TestSuiteFunc load_test_suite(const char* path);
 		
@@ -51,26 +61,60 @@ namespace snow {
 		CallFrame* find_call_frame(unw_cursor_t* cursor);
 		bool find_binding_starting_at(uintptr_t ip, std::string& out_friendly_name);
 		void register_binding(Symbol module_name, Symbol function_name, uintptr_t function_start);
+		CodeModule* find_module_containing(const void* ip) const;
 	private:
-		CodeManager() {}
+		CodeManager() : _wrote_perf_map(false) {}
+		
+		/*
+			All known code, keyed by start address: JIT modules with their full
+			extent, and native bindings, whose extent is unknown (end == start).
+			JIT regions never contain binding addresses, so the closest entry at
+			or below an address inside a module is always that module.
+		*/
+		struct CodeRange {
+			uintptr_t end;
+			CodeModule* module;   // NULL for bindings
+			Symbol module_name;   // bindings only
+			Symbol function_name; // bindings only
+		};
+		typedef std::map<uintptr_t, CodeRange> AddressIndex;
+		
 		std::vector<std::unique_ptr<CodeModule> > _modules;
-		std::map<uintptr_t, std::tuple<Symbol, Symbol> > binding_names;
+		AddressIndex _address_index;
+		CodeHeap _code_heap;
+		bool _wrote_perf_map; // the process-wide PerfMap has this isolate's earlier modules
 	};
 	
 	inline void CodeManager::register_binding(Symbol module_name, Symbol function_name, uintptr_t function_start) {
-		binding_names[function_start] = std::make_tuple(module_name, function_name);
+		CodeRange range;
+		range.end = function_start;
+		range.module = NULL;
+		range.module_name = module_name;
+		range.function_name = function_name;
+		_address_index[function_start] = range;
 	}
 	
 	inline bool CodeManager::find_binding_starting_at(uintptr_t ip, std::string& out_friendly_name) {
-		auto it = binding_names.find(ip);
-		if (it != binding_names.end()) {
-			const char* module_name = sym_to_cstr(std::get<0>(it->second));
-			const char* function_name = sym_to_cstr(std::get<1>(it->second));
+		auto it = _address_index.find(ip);
+		if (it != _address_index.end() && it->second.module == NULL) {
+			const char* module_name = sym_to_cstr(it->second.module_name);
+			const char* function_name = sym_to_cstr(it->second.function_name);
 			out_friendly_name = std::string(module_name ? module_name : "") + "#" + std::string(function_name ? function_name : "<unknown>");
 			return true;
 		}
 		return false;
 	}
+	
+	inline CodeModule* CodeManager::find_module_containing(const void* ip) const {
+		uintptr_t p = (uintptr_t)ip;
+		auto it = _address_index.upper_bound(p);
+		if (it == _address_index.begin()) return NULL;
+		--it;
+		if (it->second.module != NULL && p < it->second.end) {
+			return it->second.module;
+		}
+		return NULL;
+	}
 }
 
 #endif /* end of include guard: CODEMANAGER_HPP_JMOI6NFS */
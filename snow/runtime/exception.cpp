@@ -3,6 +3,7 @@
 #include "snow/snow.hpp"
 #include "snow/class.hpp"
 #include "snow/fiber.hpp"
+#include "snow/function.hpp"
 #include "codemanager.hpp"
 #include "snow/numeric.hpp"
 #include "internal.h"
@@ -126,7 +127,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_exception_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (root == NULL) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Exception"), get_type<Exception>());
 			SN_DEFINE_METHOD(cls, "initialize", bindings::exception_initialize);
@@ -143,27 +144,29 @@ namespace snow {
 	}
 	
 	Value try_catch_ensure(Value try_f, Value catch_f, Value ensure_f) {
-		struct Ensure {
-			Ensure(Value ensure_f) : ensure_f(ensure_f) {}
-			~Ensure() {
-				if (is_truthy(ensure_f))
-					snow::call(ensure_f, NULL, 0, NULL);
-			}
-			Value ensure_f;
-		};
-		
-		Ensure ensure(ensure_f);
 		Value result;
 		try {
-			if (is_truthy(try_f))
-				result = call(try_f, NULL, 0, NULL);
-		}
-		catch (ExceptionPtr ex) {
-			if (is_truthy(catch_f)) {
+			try {
+				if (is_truthy(try_f))
+					result = call(try_f, NULL, 0, NULL);
+			}
+			catch (ExceptionPtr ex) {
+				if (!is_truthy(catch_f))
+					throw;
 				Value args[] = { ex };
-				return call(catch_f, NULL, 1, args);
+				result = call(catch_f, NULL, 1, args);
 			}
-			throw ex;
+		}
+		catch (...) {
+			// The exception is already leaving this frame, so a `break` in the ensure block is dropped.
+			if (is_truthy(ensure_f) && call(ensure_f, NULL, 0, NULL) == SN_UNWINDING)
+				call_frame_cancel_unwind();
+			throw;
+		}
+		if (is_truthy(ensure_f)) {
+			Value ensure_result = call(ensure_f, NULL, 0, NULL);
+			if (ensure_result == SN_UNWINDING)
+				return ensure_result; // `break` in the ensure block takes over from the result.
 		}
 		return result;
 	}
@@ -9,14 +9,12 @@ struct SnObject;
 namespace snow {
 	struct CallFrame;
 	
-	static const size_t SN_FIBER_STACK_SIZE = 8*SN_MEMORY_PAGE_SIZE;
+	static const size_t SN_FIBER_STACK_SIZE = 256*SN_MEMORY_PAGE_SIZE; // reserved, committed lazily (see stackpool.hpp)
 
-	typedef VALUE(*FiberStartFunc)(FiberPtr fiber, FiberPtr caller, VALUE data);
-	typedef void(*FiberReturnFunc)(FiberPtr return_from, VALUE data);
-	typedef void(*StartFiberFunc)(FiberPtr fiber, FiberPtr caller, VALUE data, FiberStartFunc start_func, FiberReturnFunc return_callback);
-
-	void __attribute__((noreturn))
-	start_fiber(FiberPtr fiber, byte* stack, FiberPtr caller, VALUE data, FiberStartFunc start_func, FiberReturnFunc return_callback);
+	// Context switching (architecture specific, see x86-64/fiber-starter.cpp).
+	typedef void(*FiberEntryFunc)(void* data); // must never return
+	void* fiber_prepare_context(byte* stack_top, FiberEntryFunc entry, void* data); // returns the initial saved stack pointer
+	void fiber_switch_context(void** save_sp, void* restore_sp);
 
 	enum FiberFlags {
 		FiberNoFlags   = 0x0,
@@ -27,6 +25,8 @@ namespace snow {
 	void fiber_begin_thread();
 	void fiber_end_thread();
 	void fiber_suspend_for_garbage_collection(FiberPtr fiber);
+	const byte* fiber_get_current_stack_top(); // for scanning the running fiber's stack
+	const CallFrame* fiber_get_current_frame_in_signal_handler(); // NULL if the thread has no isolate or no fibers yet
 	void push_call_frame(CallFrame* frame);
 	void pop_call_frame(CallFrame* frame);
 }
@@ -1,7 +1,6 @@
 #include "snow/fiber.hpp"
 #include "fiber-internal.hpp"
 #include "internal.h"
-#include "semaphore.hpp"
 #include "snow/util.hpp"
 #include "snow/type.hpp"
 #include "snow/objectptr.hpp"
@@ -13,8 +12,8 @@
 #include "snow/str.hpp"
 #include "snow/exception.hpp"
 #include "gc-intern.hpp"
-
-#include <thread>
+#include "stackpool.hpp"
+#include "isolate-internal.hpp"
 
 namespace snow {
 	struct Fiber {
@@ -28,48 +27,70 @@ namespace snow {
 		
 		Value functor;
 		Value incoming_value;
-		std::thread* thread;
 		ObjectPtr<Fiber> resumed_by;
-		Semaphore semaphore;
+		byte* stack;       // NULL for the main fiber, which runs on the thread's stack, and until first resumed
 		byte* stack_top;
-		byte* stack_bottom;
+		void* saved_sp;    // while suspended, see fiber_switch_context
+		bool is_entered;   // false until the first switch to the fiber
 		CallFrame* current_frame;
 		State state;
+		
+		// Scheduler bookkeeping, see fiber_run_scheduler.
+		ObjectPtr<Fiber> next_runnable;
+		bool is_scheduled;   // spawned, and run by the scheduler until its functor returns
+		bool is_queued;
+		bool is_parked;
+		bool wakeup_pending; // unparked while not parked; the next park returns immediately
 
 		Fiber() :
-		functor(NULL),
+			functor(NULL),
 			incoming_value(NULL),
-			thread(NULL),
+			stack(NULL),
 			stack_top(NULL),
-			stack_bottom(NULL),
+			saved_sp(NULL),
+			is_entered(false),
 			current_frame(NULL),
-			state(Stopped)
+			state(Stopped),
+			is_scheduled(false),
+			is_queued(false),
+			is_parked(false),
+			wakeup_pending(false)
 		{
 		}
 		
 		void initialize(Value func) {
 			functor = func;
 			state = Waiting;
-			thread = new std::thread(Fiber::_start, this);
+		}
+		
+		void acquire_stack() {
+			// Deferred until the first resume, so fibers that are never run cost no stack.
+			ASSERT(stack == NULL && !is_entered);
+			stack = get_fiber_stack_pool().allocate();
+			if (stack == NULL)
+				throw_exception_with_description("Could not allocate fiber stack.");
+			stack_top = stack + SN_FIBER_STACK_SIZE;
+			saved_sp = fiber_prepare_context(stack_top, Fiber::_start, this);
 		}
 		
 		void initialize_main() {
 			functor = NULL;
-			thread = NULL;
 			state = Running;
-			stack_top = NULL;
+			is_entered = true;
 		}
 		
 		~Fiber() {
-			if (thread != NULL) {
+			if (is_entered && stack != NULL) {
 				terminate();
-				thread->join();
+			}
+			if (stack != NULL) {
+				get_fiber_stack_pool().free(stack);
 			}
 		}
 	private:
 		void start();
 		void terminate();
-		static void _start(Fiber* f) { f->start(); }
+		static void _start(void* f) { static_cast<Fiber*>(f)->start(); }
 	};
 	
 	static void fiber_gc_each_root(void* priv, GCCallback callback) {
@@ -77,32 +98,66 @@ namespace snow {
 		callback(fiber->functor);
 		callback(fiber->incoming_value);
 		callback(fiber->resumed_by);
-		if (fiber->stack_top != NULL) { // Not main fiber.
-			snow::gc_scan_fiber_stack(fiber->stack_top, fiber->stack_bottom);
+		callback(fiber->next_runnable);
+		if (fiber->state != Fiber::Running && fiber->is_entered) {
+			// Suspended; the running fiber's stack is scanned by the collector itself.
+			// Only the used part is scanned, the rest may not even be committed.
+			ASSERT(fiber->stack == NULL || ((byte*)fiber->saved_sp >= fiber->stack && (byte*)fiber->saved_sp < fiber->stack_top));
+			const byte* top = fiber->stack != NULL ? fiber->stack_top : gc_get_main_stack_top();
+			snow::gc_scan_fiber_stack(top, (const byte*)fiber->saved_sp);
 		}
 	}
 
 	SN_REGISTER_TYPE(Fiber, ((Type){ .data_size = sizeof(Fiber), .initialize = snow::construct<Fiber>, .finalize = snow::destruct<Fiber>, .copy = NULL, .gc_each_root = fiber_gc_each_root}))
 
-	static Value* _current_fiber = NULL;
+	/*
+		The fiber scheduler is cooperative and runs on a single thread, like the
+		rest of the runtime. fiber_run_scheduler turns the calling fiber into the
+		scheduler: it resumes runnable fibers in FIFO order until none are left.
+		A scheduled fiber runs until it yields (goes to the back of the queue),
+		parks (leaves the queue until someone unparks it), or returns from its
+		functor. Each of those switches back to the scheduler.
+		
+		Only spawned fibers are scheduled. A fiber driven with Fiber#resume
+		belongs to its resumer: it cannot park, and yielding does nothing.
+		
+		The run queue is an intrusive list through Fiber::next_runnable, so
+		queued fibers stay reachable from the run queue head, and scheduling does
+		not allocate.
+		
+		All of this is per isolate.
+	*/
+	struct FiberState {
+		Value* current_fiber;
+		Value* scheduler_fiber;
+		Value* run_queue_head;
+		Fiber* run_queue_tail;
+		FiberSchedulerIdleFunc idle_handler;
+	};
+	
+	static inline FiberState& fiber_state() {
+		return *current_isolate().fibers;
+	}
 
 	ObjectPtr<Fiber> get_current_fiber() {
-		return *_current_fiber;
+		return *fiber_state().current_fiber;
 	}
 
 	static void set_current_fiber(FiberPtr fiber) {
-		*_current_fiber = fiber;
+		*fiber_state().current_fiber = fiber;
 	}
 	
-	static NO_INLINE byte* get_sp() {
-		void* foo = NULL;
-		byte* ptr = (byte*)&foo;
-		return ptr;
-	}
-
 	void init_fibers() {
+		Isolate& isolate = current_isolate();
+		ASSERT(isolate.fibers == NULL);
 		ObjectPtr<Fiber> fiber = create_object_without_initialize(get_fiber_class());
-		_current_fiber = gc_create_root(fiber);
+		FiberState* state = new FiberState;
+		state->current_fiber = gc_create_root(fiber);
+		state->scheduler_fiber = gc_create_root();
+		state->run_queue_head = gc_create_root();
+		state->run_queue_tail = NULL;
+		state->idle_handler = NULL;
+		isolate.fibers = state;
 		fiber->initialize_main();
 	}
 
@@ -120,18 +175,150 @@ namespace snow {
 			throw_exception_with_description("ERROR: Cannot resume terminating fiber.");
 		
 		ASSERT(fiber->state == Fiber::Waiting || fiber->state == Fiber::Stopped);
+		if (!fiber->is_entered) fiber->acquire_stack();
 		fiber->incoming_value = incoming_value;
 		fiber->state = Fiber::Running;
 		fiber->resumed_by = current;
 		current->state = sleeping_state;
-		current->stack_bottom = get_sp();
 		set_current_fiber(fiber);
-		fiber->semaphore.signal();
-		current->semaphore.wait();
+		fiber->is_entered = true;
+		fiber_switch_context(&current->saved_sp, fiber->saved_sp);
 		if (current->state == Fiber::Terminating) throw Fiber::Terminate();
 		return current->incoming_value;
 	}
+	
+	static void enqueue_runnable(FiberPtr fiber) {
+		ASSERT(!fiber->is_queued);
+		fiber->is_queued = true;
+		fiber->next_runnable = NULL;
+		FiberState& state = fiber_state();
+		if (state.run_queue_tail != NULL) {
+			state.run_queue_tail->next_runnable = fiber;
+		} else {
+			*state.run_queue_head = fiber;
+		}
+		state.run_queue_tail = &*fiber;
+	}
+	
+	static ObjectPtr<Fiber> dequeue_runnable() {
+		FiberState& state = fiber_state();
+		ObjectPtr<Fiber> fiber = *state.run_queue_head;
+		if (fiber == NULL) return NULL;
+		*state.run_queue_head = fiber->next_runnable;
+		if (fiber->next_runnable == NULL) state.run_queue_tail = NULL;
+		fiber->next_runnable = NULL;
+		fiber->is_queued = false;
+		return fiber;
+	}
+	
+	bool fiber_is_scheduled(FiberConstPtr fiber) {
+		// Fibers resumed directly (generators) are not, even when resumed from a scheduled
+		// fiber: parking one would leave it to be resumed by the scheduler later, and its
+		// next yield would go there instead of to its resumer.
+		return fiber->is_scheduled && *fiber_state().scheduler_fiber != NULL;
+	}
+	
+	static void switch_to_scheduler() {
+		fiber_resume_internal(*fiber_state().scheduler_fiber, NULL, Fiber::Waiting);
+	}
+	
+	void fiber_run_scheduler() {
+		fiber_run_scheduler_until(NULL, NULL);
+	}
+	
+	void fiber_run_scheduler_until(FiberSchedulerDoneFunc done, void* data) {
+		FiberState& state = fiber_state();
+		if (*state.scheduler_fiber != NULL)
+			throw_exception_with_description("Fiber scheduler is already running.");
+		*state.scheduler_fiber = get_current_fiber();
+		try {
+			while (done == NULL || !done(data)) {
+				ObjectPtr<Fiber> fiber = dequeue_runnable();
+				if (fiber == NULL) {
+					// Everything is parked. Wait for whatever the parked fibers are waiting on, if anything.
+					if (state.idle_handler != NULL && state.idle_handler()) continue;
+					break;
+				}
+				if (fiber->state == Fiber::Terminating) continue;
+				fiber_resume_internal(fiber, NULL, Fiber::Waiting);
+			}
+		}
+		catch (...) {
+			*state.scheduler_fiber = NULL;
+			throw;
+		}
+		*state.scheduler_fiber = NULL;
+	}
+	
+	bool fiber_scheduler_is_running() {
+		return *fiber_state().scheduler_fiber != NULL;
+	}
+	
+	void fiber_set_scheduler_idle_handler(FiberSchedulerIdleFunc handler) {
+		FiberState& state = fiber_state();
+		// The handler blocks until there is work, so two of them could not take turns.
+		if (handler != NULL && state.idle_handler != NULL && state.idle_handler != handler)
+			throw_exception_with_description("Fiber scheduler already has an idle handler.");
+		state.idle_handler = handler;
+	}
+	
+	void fiber_yield() {
+		ObjectPtr<Fiber> current = get_current_fiber();
+		if (!fiber_is_scheduled(current)) return; // nothing else to run
+		enqueue_runnable(current);
+		switch_to_scheduler();
+	}
+	
+	void fiber_park() {
+		ObjectPtr<Fiber> current = get_current_fiber();
+		if (current->wakeup_pending) {
+			current->wakeup_pending = false;
+			return;
+		}
+		if (!fiber_is_scheduled(current))
+			throw_exception_with_description("Cannot park a fiber that is not run by the fiber scheduler.");
+		current->is_parked = true;
+		switch_to_scheduler();
+	}
+	
+	void fiber_unpark(FiberPtr fiber) {
+		if (fiber->is_parked) {
+			fiber->is_parked = false;
+			enqueue_runnable(fiber);
+		} else if (!fiber->is_entered && !fiber->is_queued) {
+			fiber->is_scheduled = true; // not started yet
+			enqueue_runnable(fiber);
+		} else {
+			fiber->wakeup_pending = true;
+		}
+	}
+	
+	bool fiber_is_parked(FiberConstPtr fiber) {
+		return fiber->is_parked;
+	}
+	
+	ObjectPtr<Fiber> fiber_spawn(Value functor) {
+		ObjectPtr<Fiber> fiber = create_fiber(functor);
+		fiber->is_scheduled = true;
+		enqueue_runnable(fiber);
+		return fiber;
+	}
+	
+	const byte* fiber_get_current_stack_top() {
+		if (current_isolate().fibers == NULL) return gc_get_main_stack_top(); // fibers not initialized yet
+		ObjectPtr<Fiber> current = get_current_fiber();
+		return current->stack != NULL ? current->stack_top : gc_get_main_stack_top();
+	}
 
+	const CallFrame* fiber_get_current_frame_in_signal_handler() {
+		// The signal may land on any thread, including one without an isolate, so this
+		// can't go through current_isolate(), which asserts.
+		Isolate* isolate = _current_isolate;
+		if (isolate == NULL || isolate->fibers == NULL) return NULL;
+		ObjectPtr<Fiber> current = *isolate->fibers->current_fiber;
+		return current != NULL ? current->current_frame : NULL;
+	}
+	
 	Value fiber_resume(FiberPtr fiber, Value incoming_value) {
 		return fiber_resume_internal(fiber, incoming_value, Fiber::Waiting);
 	}
@@ -145,32 +332,35 @@ namespace snow {
 	}
 	
 	void Fiber::start() {
-		stack_top = get_sp();
-		stack_bottom = stack_top;
-		
-		semaphore.wait();
 		try {
 			while (state != Terminating) {
-				Value val = snow::call(functor, NULL, 2, (Value[]){ resumed_by, incoming_value });
+				Value args[] = { resumed_by, incoming_value };
+				Value val = snow::call(functor, NULL, 2, args);
+				is_scheduled = false; // done; whoever resumes it again drives it directly
 				incoming_value = fiber_resume_internal(resumed_by, val, Stopped);
 			}
 		}
 		catch (Fiber::Terminate t) {
-			fiber_resume_internal(resumed_by, SN_NIL, Terminating);
+			// Unwound; hand control back for good. This stack is never switched to again.
+			ObjectPtr<Fiber> back = resumed_by;
+			back->state = Running;
+			set_current_fiber(back);
+			fiber_switch_context(&saved_sp, back->saved_sp);
 		}
+		TRAP(); // unreachable
 	}
 	
 	void Fiber::terminate() {
+		// Switch to the fiber with the Terminating state, which makes it throw Fiber::Terminate
+		// from where it was suspended, so its C++ frames are unwound properly.
 		ObjectPtr<Fiber> current = get_current_fiber();
 		if (&*current == this)
 			TRAP(); // terminating current fiber.
 		state = Terminating;
 		resumed_by = current;
 		current->state = Waiting;
-		
-		semaphore.signal();
-		current->semaphore.wait();
-		ASSERT(current->state = Running);
+		fiber_switch_context(&current->saved_sp, saved_sp);
+		ASSERT(current->state == Running);
 	}
 
 	void push_call_frame(CallFrame* frame) {
@@ -193,7 +383,7 @@ namespace snow {
 			Value functor = fiber->functor;
 
 			ObjectPtr<String> inspected_functor = value_inspect(functor);
-			ObjectPtr<String> result = format_string("[Fiber@%@ stack:[%@-%@] functor:", format::pointer(fiber), fiber->stack_bottom, fiber->stack_top);
+			ObjectPtr<String> result = format_string("[Fiber@%@ stack:[%@-%@] functor:", format::pointer(fiber), format::pointer(fiber->stack), format::pointer(fiber->stack_top));
 			string_append(result, inspected_functor);
 			string_append_cstr(result, "]");
 			return result;
@@ -217,11 +407,20 @@ namespace snow {
 			ASSERT(f != NULL);
 			while (f->state == Fiber::Waiting) {
 				Value result = fiber_resume(f, NULL);
-				call(it, NULL, 1, &result);
+				if (call(it, NULL, 1, &result) == SN_UNWINDING) return SN_UNWINDING;
 			}
 			return SN_NIL;
 		}
 
+		static VALUE fiber_unpark(const CallFrame* here, VALUE self, VALUE it) {
+			snow::fiber_unpark(self);
+			return self;
+		}
+		
+		static VALUE fiber_is_parked(const CallFrame* here, VALUE self, VALUE it) {
+			return boolean_to_value(snow::fiber_is_parked(self));
+		}
+		
 		static VALUE fiber_initialize(const CallFrame* here, VALUE self, VALUE it) {
 			ObjectPtr<Fiber> fiber = self;
 			fiber->initialize(it);
@@ -230,7 +429,7 @@ namespace snow {
 	}
 
 	ObjectPtr<Class> get_fiber_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Fiber"), snow::get_type<Fiber>());
 			SN_DEFINE_METHOD(cls, "initialize", bindings::fiber_initialize);
@@ -239,8 +438,10 @@ namespace snow {
 			SN_DEFINE_METHOD(cls, "resume", bindings::fiber_resume);
 			SN_DEFINE_METHOD(cls, "__call__", bindings::fiber_resume);
 			SN_DEFINE_METHOD(cls, "each", bindings::fiber_each);
+			SN_DEFINE_METHOD(cls, "unpark", bindings::fiber_unpark);
 			SN_DEFINE_PROPERTY(cls, "running?", bindings::fiber_is_running, NULL);
 			SN_DEFINE_PROPERTY(cls, "started?", bindings::fiber_is_started, NULL);
+			SN_DEFINE_PROPERTY(cls, "parked?", bindings::fiber_is_parked, NULL);
 			root = gc_create_root(cls);
 		}
 		return *root;
@@ -10,6 +10,7 @@
 #include "snow/array.hpp"
 #include "snow/module.hpp"
 #include "inline-cache.hpp"
+#include "isolate-internal.hpp"
 
 namespace snow {
 	struct Function {
@@ -70,6 +71,21 @@ namespace snow {
 	}
 	
 	SN_REGISTER_CPP_TYPE(Environment, environment_gc_each_root)
+	
+	struct BoundMethod {
+		Value self;
+		Value method;
+		
+		BoundMethod() : self(NULL), method(NULL) {}
+	};
+	
+	static void bound_method_gc_each_root(void* priv, GCCallback callback) {
+		auto bound = static_cast<BoundMethod*>(priv);
+		callback(bound->self);
+		callback(bound->method);
+	}
+	
+	SN_REGISTER_CPP_TYPE(BoundMethod, bound_method_gc_each_root)
 
 	ObjectPtr<Function> create_function_for_descriptor(const FunctionDescriptor* descriptor, ObjectPtr<Environment> definition_scope) {
 		ObjectPtr<Function> function = create_object(get_function_class(), 0, NULL);
@@ -115,6 +131,17 @@ namespace snow {
 			return format_string("[Function@%@ name:%@ code:%@]", format::pointer(self), sym_to_cstr(f->descriptor->name), format::pointer(f->descriptor->ptr));
 		}
 
+		static VALUE bound_method_call(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<BoundMethod> bound = self;
+			ASSERT(bound != NULL);
+			return call_with_arguments(bound->method, bound->self, *here->args);
+		}
+		
+		static VALUE bound_method_inspect(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<BoundMethod> bound = self;
+			return format_string("[BoundMethod@%@ self:%@ method:%@]", format::pointer(self), value_inspect(bound->self), value_inspect(bound->method));
+		}
+
 		static VALUE environment_get_self(const CallFrame* here, VALUE self, VALUE it) {
 			return ObjectPtr<Environment>(self)->self;
 		}
@@ -148,7 +175,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_function_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Function"), snow::get_type<Function>());
 			root = gc_create_root(cls);
@@ -158,6 +185,17 @@ namespace snow {
 		return *root;
 	}
 	
+	ObjectPtr<Class> get_bound_method_class() {
+		static IsolateRoot root;
+		if (!root) {
+			ObjectPtr<Class> cls = create_class_for_type(snow::sym("BoundMethod"), snow::get_type<BoundMethod>());
+			root = gc_create_root(cls);
+			SN_DEFINE_METHOD(cls, "__call__", bindings::bound_method_call);
+			SN_DEFINE_METHOD(cls, "inspect", bindings::bound_method_inspect);
+		}
+		return *root;
+	}
+	
 	ObjectPtr<Environment> call_frame_environment(CallFrame* frame) {
 		if (frame->environment != NULL) return frame->environment;
 		
@@ -199,7 +237,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_environment_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Environment"), get_type<Environment>());
 			SN_DEFINE_PROPERTY(cls, "self", bindings::environment_get_self, NULL);
@@ -212,9 +250,16 @@ namespace snow {
 	ObjectPtr<Function> value_to_function(Value val, Value* out_new_self) {
 		Value functor = val;
 		while (!snow::value_is_of_type(functor, get_type<Function>())) {
+			if (snow::value_is_of_type(functor, get_type<BoundMethod>())) {
+				ObjectPtr<const BoundMethod> bound = functor;
+				*out_new_self = bound->self;
+				functor = bound->method;
+				continue;
+			}
+			
 			ObjectPtr<Class> cls = get_class(functor);
 			MethodQueryResult method;
-			if (class_lookup_method(cls, snow::sym("__call__"), &method)) {
+			if (class_lookup_method(cls, SN_SYM(__call__), &method)) {
 				*out_new_self = functor;
 				if (method.type == MethodTypeFunction) {
 					functor = method.result;
@@ -243,6 +288,44 @@ namespace snow {
 		return NULL; // Value cannot be converted to function.
 	}
 	
+	VALUE call_frame_begin_unwind(const CallFrame* here) {
+		ObjectPtr<Environment> target = here->function->definition_scope;
+		if (target == NULL)
+			throw_exception_with_description("Cannot break outside of a loop.");
+		for (const CallFrame* frame = here->caller; frame != NULL; frame = frame->caller) {
+			if (frame->environment == target) {
+				// The isolate remembers the environment of the frame being unwound to.
+				// That frame is live while unwinding, so the environment is reachable.
+				current_isolate().unwind_target = target.value();
+				return SN_UNWINDING;
+			}
+		}
+		throw_exception_with_description("Cannot break from a block whose defining function has returned.");
+		return NULL; // unreachable
+	}
+	
+	VALUE call_frame_finish_unwind(const CallFrame* here) {
+		Object*& unwind_target = current_isolate().unwind_target;
+		ASSERT(unwind_target != NULL);
+		if (here->environment != NULL && here->environment.value() == unwind_target) {
+			unwind_target = NULL;
+			return SN_NIL;
+		}
+		return SN_UNWINDING;
+	}
+	
+	VALUE call_frame_forbid_unwind(VALUE result, const char* through) {
+		if (result == SN_UNWINDING) {
+			call_frame_cancel_unwind();
+			throw_exception_with_description("Cannot break out of a block through %@.", through);
+		}
+		return result;
+	}
+	
+	void call_frame_cancel_unwind() {
+		current_isolate().unwind_target = NULL;
+	}
+	
 	namespace {
 		struct CallFramePusher {
 			CallFramePusher(CallFrame* frame) : frame(frame) {
@@ -302,19 +385,10 @@ namespace snow {
 		return function->module;
 	}
 	
-	static VALUE method_proxy_call(const CallFrame* here, VALUE self, VALUE it) {
-		ASSERT(is_object(self));
-		auto obj = object_get_instance_variable(self, snow::sym("object"));
-		auto method = object_get_instance_variable(self, snow::sym("method"));
-		return call_with_arguments(method, obj, *here->args);
-	}
-
-	AnyObjectPtr create_method_proxy(Value self, Value method) {
-		// TODO: Use a real class for proxy methods
-		AnyObjectPtr obj = create_object(get_object_class(), 0, NULL);
-		SN_OBJECT_DEFINE_METHOD(obj, "__call__", method_proxy_call);
-		object_set_instance_variable(obj, snow::sym("object"), self);
-		object_set_instance_variable(obj, snow::sym("method"), method);
-		return obj;
+	AnyObjectPtr create_bound_method(Value self, Value method) {
+		ObjectPtr<BoundMethod> bound = create_object_without_initialize(get_bound_method_class());
+		bound->self = self;
+		bound->method = method;
+		return bound;
 	}
 }
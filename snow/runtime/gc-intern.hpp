@@ -3,7 +3,14 @@
 #define GC_INTERN_HPP_ARWL9D38
 
 namespace snow {
+	void gc_collect(const byte* stack_bottom); // the running fiber's stack is scanned from stack_bottom up
+	
+	// The two halves of gc_collect. Sweeping runs finalizers, so it must happen on the heap's own
+	// thread, and before the mutator touches the heap again; marking may happen on another thread.
+	void gc_mark(const byte* stack_bottom);
+	void gc_finish_pending_sweep(); // does nothing if nothing was marked
 	void gc_scan_fiber_stack(const byte* top, const byte* bottom);
+	const byte* gc_get_main_stack_top();
 }
 
 #endif /* end of include guard: GC_INTERN_HPP_ARWL9D38 */
@@ -2,8 +2,11 @@
 #include "gc-intern.hpp"
 
 #include "snow/object.hpp"
+#include "snow/class.hpp"
 #include "snow/fiber.hpp"
 #include "fiber-internal.hpp"
+#include "isolate-internal.hpp"
+#include "safepoint.hpp"
 
 #include "allocator.hpp"
 #include "linkheap.hpp"
@@ -16,6 +19,23 @@
 #include <malloc/malloc.h>
 
 namespace snow {
+	// One isolate's heap: its allocator, collector state and external roots.
+	struct GCHeap {
+		size_t collection_threshold;
+		const byte* stack_top;
+		const byte* stack_bottom;
+		uint8_t* object_flags;
+		size_t num_object_flags;
+		
+		struct {
+			size_t num_objects;
+			size_t memory_usage;
+		} stats;
+		
+		Allocator allocator;
+		std::vector<Value*> external_roots;
+	};
+	
 	namespace {
 		enum GCFlags {
 			GCNoFlags = 0,
@@ -23,47 +43,41 @@ namespace snow {
 			GCFreed = 2,
 		};
 		
-		static struct {
-			size_t collection_threshold;
-			const byte* stack_top;
-			const byte* stack_bottom;
-			uint8_t* object_flags;
-			size_t num_object_flags;
-			
-			struct {
-				size_t num_objects;
-				size_t memory_usage;
-			} stats;
-		} GC;
-		
-		static Allocator allocator;
-		static std::vector<Value*> external_roots;
+		inline GCHeap& heap() {
+			return *current_isolate().heap;
+		}
 		
 		void start_collection() {
-			GC.num_object_flags = allocator.capacity();
-			GC.object_flags = new uint8_t[GC.num_object_flags];
-			snow::assign_range(GC.object_flags, (uint8_t)GCNoFlags, GC.num_object_flags);
+			GCHeap& h = heap();
+			delete[] h.object_flags; // marked by another thread, but not swept yet; just mark again
+			h.num_object_flags = h.allocator.capacity();
+			h.object_flags = new uint8_t[h.num_object_flags];
+			snow::assign_range(h.object_flags, (uint8_t)GCNoFlags, h.num_object_flags);
 		}
 		
 		void finish_collection() {
-			GC.num_object_flags = 0;
-			delete[] GC.object_flags;
-			GC.object_flags = NULL;
+			GCHeap& h = heap();
+			h.num_object_flags = 0;
+			delete[] h.object_flags;
+			h.object_flags = NULL;
 		}
 		
 		void adjust_collection_threshold() {
-			size_t candidate = GC.stats.num_objects * 2;
-			if (candidate > GC.collection_threshold) {
-				GC.collection_threshold = candidate;
+			GCHeap& h = heap();
+			size_t candidate = h.stats.num_objects * 2;
+			if (candidate > h.collection_threshold) {
+				h.collection_threshold = candidate;
 			}
 		}
 		
 		uint8_t& flags_of(void* ptr) {
-			return GC.object_flags[allocator.index_of_object(ptr)];
+			GCHeap& h = heap();
+			return h.object_flags[h.allocator.index_of_object(ptr)];
 		}
 		
 		void scan_free_list() {
-			for (auto it = allocator.free_list_begin(); it != allocator.free_list_end(); ++it) {
+			GCHeap& h = heap();
+			for (auto it = h.allocator.free_list_begin(); it != h.allocator.free_list_end(); ++it) {
 				flags_of(*it) |= GCFreed;
 			}
 		}
@@ -98,7 +112,8 @@ namespace snow {
 		}
 		
 		void scan_external_roots() {
-			for (auto it = external_roots.begin(); it != external_roots.end(); ++it) {
+			GCHeap& h = heap();
+			for (auto it = h.external_roots.begin(); it != h.external_roots.end(); ++it) {
 				scan_definite_value(**it);
 			}
 		}
@@ -106,9 +121,10 @@ namespace snow {
 		void scan_possible_value(VALUE val) {
 			if (is_object(val)) {
 				size_t flag_index;
-				Object* object = allocator.find_object_and_index(val, flag_index);
+				GCHeap& h = heap();
+				Object* object = h.allocator.find_object_and_index(val, flag_index);
 				if (object != NULL) {
-					scan_definite_object(object, GC.object_flags[flag_index]);
+					scan_definite_object(object, h.object_flags[flag_index]);
 				}
 			}
 		}
@@ -118,12 +134,13 @@ namespace snow {
 		}
 		
 		void scan_stack(const byte* stack_bottom) {
-			gc_scan_fiber_stack(GC.stack_top, stack_bottom);
+			gc_scan_fiber_stack(fiber_get_current_stack_top(), stack_bottom);
 		}
 
 		Object* allocate_object(const Type* type) {
 			ASSERT(sizeof(Object) <= SN_CACHE_LINE_SIZE - sizeof(void*));
-			Object* obj = allocator.allocate();
+			GCHeap& h = heap();
+			Object* obj = h.allocator.allocate();
 			obj->type = type;
 			void* data = obj + 1;
 			if (type) {
@@ -134,8 +151,8 @@ namespace snow {
 				}
 				type->initialize(data);
 			}
-			++GC.stats.num_objects;
-			GC.stats.memory_usage += sizeof(Object) + (type ? type->data_size : 0);
+			++h.stats.num_objects;
+			h.stats.memory_usage += sizeof(Object) + (type ? type->data_size : 0);
 			return obj;
 		}
 
@@ -149,16 +166,18 @@ namespace snow {
 				}
 			}
 			snow::dealloc_range(obj->members, obj->num_alloc_members);
-			allocator.free(obj);
-			--GC.stats.num_objects;
-			GC.stats.memory_usage -= sizeof(Object) + (type ? type->data_size : 0);
+			GCHeap& h = heap();
+			h.allocator.free(obj);
+			--h.stats.num_objects;
+			h.stats.memory_usage -= sizeof(Object) + (type ? type->data_size : 0);
 		}
 		
 		void free_unreachable() {
-			for (size_t i = 0; i < GC.num_object_flags; ++i) {
-				uint8_t& flags = GC.object_flags[i];
+			GCHeap& h = heap();
+			for (size_t i = 0; i < h.num_object_flags; ++i) {
+				uint8_t& flags = h.object_flags[i];
 				if (!(flags & GCFreed) && !(flags & GCReachable)) {
-					Object* obj = allocator.object_at_index(i);
+					Object* obj = h.allocator.object_at_index(i);
 					free_object(obj);
 				}
 			}
@@ -166,47 +185,67 @@ namespace snow {
 	}
 	
 	void init_gc(void** stk_top) {
-		GC.collection_threshold = Allocator::OBJECTS_PER_BLOCK * 4;
-		GC.stack_top = (const byte*)stk_top;
-		GC.stack_bottom = NULL;
-		GC.object_flags = NULL;
-		GC.num_object_flags = 0;
-		GC.stats.num_objects = 0;
-		GC.stats.memory_usage = 0;
+		Isolate& isolate = current_isolate();
+		ASSERT(isolate.heap == NULL);
+		GCHeap& h = *(isolate.heap = new GCHeap);
+		h.collection_threshold = Allocator::OBJECTS_PER_BLOCK * 4;
+		h.stack_top = (const byte*)stk_top;
+		h.stack_bottom = NULL;
+		h.object_flags = NULL;
+		h.num_object_flags = 0;
+		h.stats.num_objects = 0;
+		h.stats.memory_usage = 0;
 	}
 	
 	void gc() {
+		void* sp = NULL;
+		gc_collect((const byte*)&sp);
+	}
+	
+	void gc_collect(const byte* stack_bottom) {
+		gc_mark(stack_bottom);
+		gc_finish_pending_sweep();
+	}
+	
+	void gc_mark(const byte* stack_bottom) {
 		start_collection();
-		ssize_t num_before = GC.stats.num_objects;
-		size_t memory_usage_before = GC.stats.memory_usage;
 		scan_free_list();
 		scan_external_roots();
-		void* sp = NULL;
-		scan_stack((const byte*)&sp);
+		scan_stack(stack_bottom);
+	}
+	
+	void gc_finish_pending_sweep() {
+		GCHeap* h = current_isolate().heap;
+		if (h == NULL || h->object_flags == NULL) return; // nothing marked
+		ssize_t num_before = heap().stats.num_objects;
+		size_t memory_usage_before = heap().stats.memory_usage;
 		free_unreachable();
+		class_invalidate_method_cache();
 		adjust_collection_threshold();
-		ssize_t num_after = GC.stats.num_objects;
-		size_t memory_usage_after = GC.stats.memory_usage;
+		ssize_t num_after = heap().stats.num_objects;
+		size_t memory_usage_after = heap().stats.memory_usage;
 		finish_collection();
 		
-		fprintf(stderr, "GC: Collection reclaimed %lu of %lu objects (%lu of %lu bytes), new threshold: %lu.\n", num_before - num_after, num_before, memory_usage_before - memory_usage_after, memory_usage_before, GC.collection_threshold);
+		fprintf(stderr, "GC: Collection reclaimed %lu of %lu objects (%lu of %lu bytes), new threshold: %lu.\n", num_before - num_after, num_before, memory_usage_before - memory_usage_after, memory_usage_before, heap().collection_threshold);
 	}
 	
 	Value* gc_create_root(Value initial_value) {
 		Value* root = new Value(initial_value);
-		external_roots.push_back(root);
+		heap().external_roots.push_back(root);
 		return root;
 	}
 	
 	Value gc_free_root(Value* root) {
 		Value v = *root;
-		auto it = std::find(external_roots.begin(), external_roots.end(), root);
-		external_roots.erase(it);
+		std::vector<Value*>& roots = heap().external_roots;
+		roots.erase(std::find(roots.begin(), roots.end(), root));
 		return v;
 	}
 	
 	Object* gc_allocate_object(const Type* type) {
-		if (GC.stats.num_objects >= GC.collection_threshold) {
+		safepoint_poll();
+		GCHeap& h = heap();
+		if (h.stats.num_objects >= h.collection_threshold) {
 			snow::gc();
 		}
 		Object* obj = allocate_object(type);
@@ -214,6 +253,10 @@ namespace snow {
 		return obj;
 	}
 	
+	const byte* gc_get_main_stack_top() {
+		return heap().stack_top;
+	}
+	
 	void gc_scan_fiber_stack(const byte* top, const byte* bottom) {
 		ASSERT(bottom < top);
 		bottom = (const byte*)((uintptr_t)bottom & (UINTPTR_MAX - 0xf)); // align
@@ -228,21 +271,28 @@ namespace snow {
 	
 	#if defined(__APPLE__)
 	
+	namespace {
+		inline size_t* current_memory_usage() { // NULL before the isolate's heap is set up
+			return _current_isolate != NULL && _current_isolate->heap != NULL ? &_current_isolate->heap->stats.memory_usage : NULL;
+		}
+	}
+	
 	void* allocate_memory(size_t size) {
 		void* ptr = ::malloc(size);
-		GC.stats.memory_usage += ::malloc_size(ptr);
+		if (size_t* usage = current_memory_usage()) *usage += ::malloc_size(ptr);
 		return ptr;
 	}
 	
 	void* reallocate_memory(void* ptr, size_t new_size) {
-		GC.stats.memory_usage -= ::malloc_size(ptr);
+		size_t* usage = current_memory_usage();
+		if (usage) *usage -= ::malloc_size(ptr);
 		ptr = ::realloc(ptr, new_size);
-		GC.stats.memory_usage += ::malloc_size(ptr);
+		if (usage) *usage += ::malloc_size(ptr);
 		return ptr;
 	}
 	
 	void free_memory(void* ptr) {
-		GC.stats.memory_usage -= malloc_size(ptr);
+		if (size_t* usage = current_memory_usage()) *usage -= malloc_size(ptr);
 		::free(ptr);
 	}
 	
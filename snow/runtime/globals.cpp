@@ -2,6 +2,7 @@
 #include "internal.h"
 #include "snow/array.hpp"
 #include "snow/boolean.hpp"
+#include "snow/channel.hpp"
 #include "snow/class.hpp"
 #include "snow/exception.hpp"
 #include "snow/fiber.hpp"
@@ -13,6 +14,10 @@
 #include "snow/snow.hpp"
 #include "snow/str.hpp"
 #include "snow/value.hpp"
+#include "profiler.hpp"
+#include "parallel.hpp"
+
+#include <vector>
 
 using namespace snow;
 
@@ -25,11 +30,32 @@ static VALUE get_version(const CallFrame* here, VALUE self, VALUE it) {
 	return create_string_constant(snow::version());
 }
 
+static VALUE vm_start_profiler(const CallFrame* here, VALUE self, VALUE it) {
+	int64_t frequency = is_integer(it) ? value_to_integer(it) : 1000;
+	if (frequency < 1 || frequency > SN_PROFILER_MAX_FREQUENCY_HZ) {
+		throw_exception_with_description("start_profiler: Frequency must be between 1 and %@ Hz, got %@.", (int64_t)SN_PROFILER_MAX_FREQUENCY_HZ, frequency);
+	}
+	return boolean_to_value(profiler_start((unsigned int)frequency));
+}
+
+static VALUE vm_stop_profiler(const CallFrame* here, VALUE self, VALUE it) {
+	profiler_stop();
+	std::string folded = profiler_get_folded_stacks();
+	return create_string_with_size(folded.data(), folded.size());
+}
+
+static VALUE vm_is_profiling(const CallFrame* here, VALUE self, VALUE it) {
+	return boolean_to_value(profiler_is_running());
+}
+
 Value snow_get_vm_interface() {
-	static Value* root = NULL;
+	static IsolateRoot root;
 	if (!root) {
 		ObjectPtr<Class> cls = create_class(snow::sym("SnowVMInterface"), NULL);
 		SN_DEFINE_PROPERTY(cls, "version", get_version, NULL);
+		SN_DEFINE_PROPERTY(cls, "profiling", vm_is_profiling, NULL);
+		SN_DEFINE_METHOD(cls, "start_profiler", vm_start_profiler);
+		SN_DEFINE_METHOD(cls, "stop_profiler", vm_stop_profiler);
 		Value obj = create_object(cls, 0, NULL);
 		root = gc_create_root(obj);
 	}
@@ -89,6 +115,58 @@ static VALUE global_print_call_stack(const CallFrame* here, VALUE self, VALUE it
 	return SN_NIL;
 }
 
+static VALUE global_spawn(const CallFrame* here, VALUE self, VALUE it) {
+	return fiber_spawn(it);
+}
+
+static VALUE global_run_fibers(const CallFrame* here, VALUE self, VALUE it) {
+	fiber_run_scheduler();
+	return SN_NIL;
+}
+
+static VALUE global_yield(const CallFrame* here, VALUE self, VALUE it) {
+	fiber_yield();
+	return SN_NIL;
+}
+
+static VALUE global_park(const CallFrame* here, VALUE self, VALUE it) {
+	fiber_park();
+	return SN_NIL;
+}
+
+static VALUE global_select(const CallFrame* here, VALUE self, VALUE it) {
+	size_t num_channels = here->args ? here->args->size() : 0;
+	if (num_channels == 0) {
+		throw_exception_with_description("select: Expected at least one channel.");
+	}
+	std::vector<ChannelPtr> channels;
+	channels.reserve(num_channels);
+	for (size_t i = 0; i < num_channels; ++i) {
+		ChannelPtr channel;
+		channel = (*here->args)[i];
+		if (channel == NULL) {
+			throw_exception_with_description("select: Expected a channel, got %@.", value_inspect((*here->args)[i]));
+		}
+		channels.push_back(channel);
+	}
+	Value result[3]; // @(channel, value, closed)
+	bool closed;
+	size_t index = channel_select(channels.data(), num_channels, &result[1], &closed);
+	result[0] = channels[index];
+	result[2] = boolean_to_value(closed);
+	return create_array_from_range(result, result + 3);
+}
+
+static VALUE global_parallel_thread(const CallFrame* here, VALUE self, VALUE it) {
+	if (here->args == NULL) return create_array();
+	return parallel_thread(here->args->begin(), here->args->size());
+}
+
+static VALUE global_parallel_fork(const CallFrame* here, VALUE self, VALUE it) {
+	if (here->args == NULL) return create_array();
+	return parallel_fork(here->args->begin(), here->args->size());
+}
+
 static VALUE global_throw(const CallFrame* here, VALUE self, VALUE it) {
 	throw_exception(it);
 	return NULL; // unreachable
@@ -106,6 +184,13 @@ void snow_init_globals() {
 	SN_DEFINE_GLOBAL("__resolve_symbol__", global_resolve_symbol, 1);
 	SN_DEFINE_GLOBAL("__print_call_stack__", global_print_call_stack, 0);
 	SN_DEFINE_GLOBAL("throw", global_throw, 1);
+	SN_DEFINE_GLOBAL("spawn", global_spawn, 1);
+	SN_DEFINE_GLOBAL("run_fibers", global_run_fibers, 0);
+	SN_DEFINE_GLOBAL("yield", global_yield, 0);
+	SN_DEFINE_GLOBAL("park", global_park, 0);
+	SN_DEFINE_GLOBAL("select", global_select, -1);
+	SN_DEFINE_GLOBAL("__parallel_thread__", global_parallel_thread, -1);
+	SN_DEFINE_GLOBAL("__parallel_fork__", global_parallel_fork, -1);
 	
 	set_global(snow::sym("Integer"), get_integer_class());
 	set_global(snow::sym("Nil"), get_nil_class());
@@ -123,4 +208,5 @@ void snow_init_globals() {
 	set_global(snow::sym("Function"), get_function_class());
 	set_global(snow::sym("Environment"), get_environment_class());
 	set_global(snow::sym("Fiber"), get_fiber_class());
+	set_global(snow::sym("Channel"), get_channel_class());
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef ISOLATE_INTERNAL_HPP_D2XN6FWT
+#define ISOLATE_INTERNAL_HPP_D2XN6FWT
+
+#include "snow/isolate.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace snow {
+	struct Object;
+	struct GCHeap;
+	struct FiberState;
+	struct ModuleRegistry;
+	struct MethodCache;
+	class FiberStackPool;
+	class CodeManager;
+	
+	// Stop-the-world handshake between an isolate's thread and other threads, see safepoint.hpp.
+	enum MutatorState {
+		MutatorRunning, // may touch the heap at any time
+		MutatorParked,  // stopped at a safepoint
+		MutatorBlocked, // in a SafeRegion, will not touch the heap until it leaves
+	};
+	
+	struct SafepointState {
+		std::atomic<uint8_t> requested; // polled by compiled code
+		MutatorState mutator;
+		const byte* stack_bottom;       // published while not running
+		std::mutex lock;
+		std::condition_variable changed;
+		
+		SafepointState() : requested(0), mutator(MutatorRunning), stack_bottom(NULL) {}
+	};
+	
+	// Each subsystem creates its part lazily the first time it runs in an isolate.
+	struct Isolate {
+		GCHeap* heap;                 // gc.cpp
+		FiberState* fibers;           // fiber.cpp
+		FiberStackPool* stack_pool;   // stackpool.cpp
+		CodeManager* code_manager;    // codemanager.cpp
+		ModuleRegistry* modules;      // module.cpp
+		MethodCache* method_cache;    // class.cpp
+		std::vector<Value*> roots;    // IsolateRoot slots
+		std::map<const void*, void*> data;
+		SafepointState safepoint;     // safepoint.cpp
+		Object* unwind_target;        // function.cpp, while a non-local block exit unwinds
+		
+		Isolate() : heap(NULL), fibers(NULL), stack_pool(NULL), code_manager(NULL), modules(NULL), method_cache(NULL), unwind_target(NULL) {}
+	};
+	
+	extern __thread Isolate* _current_isolate;
+	size_t isolate_count(); // created so far; isolates are never destroyed
+	
+	inline Isolate& current_isolate() {
+		ASSERT(_current_isolate != NULL); // snow::init not called on this thread
+		return *_current_isolate;
+	}
+}
+
+#endif /* end of include guard: ISOLATE_INTERNAL_HPP_D2XN6FWT */
@@ -0,0 +1,56 @@
+#include "isolate-internal.hpp"
+#include "internal.h"
+
+#include <atomic>
+
+namespace snow {
+	__thread Isolate* _current_isolate = NULL;
+	
+	namespace {
+		std::atomic<size_t> num_root_slots(0);
+		std::atomic<size_t> num_isolates(0);
+	}
+	
+	Isolate* create_isolate() {
+		++num_isolates;
+		return new Isolate;
+	}
+	
+	size_t isolate_count() {
+		return num_isolates;
+	}
+	
+	Isolate* get_current_isolate() {
+		return _current_isolate;
+	}
+	
+	Isolate* set_current_isolate(Isolate* isolate) {
+		Isolate* previous = _current_isolate;
+		_current_isolate = isolate;
+		return previous;
+	}
+	
+	IsolateRoot::IsolateRoot() : _slot(num_root_slots++) {}
+	
+	Value* IsolateRoot::get() const {
+		const std::vector<Value*>& roots = current_isolate().roots;
+		return _slot < roots.size() ? roots[_slot] : NULL;
+	}
+	
+	IsolateRoot& IsolateRoot::operator=(Value* root) {
+		std::vector<Value*>& roots = current_isolate().roots;
+		if (_slot >= roots.size()) roots.resize(_slot + 1, NULL);
+		roots[_slot] = root;
+		return *this;
+	}
+	
+	void* isolate_get_data(const void* key) {
+		const std::map<const void*, void*>& data = current_isolate().data;
+		auto it = data.find(key);
+		return it != data.end() ? it->second : NULL;
+	}
+	
+	void isolate_set_data(const void* key, void* data) {
+		current_isolate().data[key] = data;
+	}
+}
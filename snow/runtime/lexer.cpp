@@ -326,6 +326,12 @@ namespace snow {
 					} else
 					if (strings_equal(p, operator_len, "!")) {
 						t = Token::LOG_NOT;
+					} else
+					if (strings_equal(p, operator_len, "||")) {
+						t = Token::PARALLEL_THREAD;
+					} else
+					if (strings_equal(p, operator_len, "|||")) {
+						t = Token::PARALLEL_FORK;
 					}
 					
 					_buffer.push(Token(t, p, operator_len, current_line_number, current_line_begin));
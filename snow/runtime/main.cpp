@@ -9,6 +9,8 @@
 #include "snow/module.hpp"
 #include "snow/object.hpp"
 #include "snow/parser.hpp"
+#include "codemanager.hpp"
+#include "profiler.hpp"
 #include "snow/str.hpp"
 #include "snow/numeric.hpp"
 #include "snow/str-format.hpp"
@@ -82,6 +84,10 @@ int main(int argc, char* const* argv) {
 	static int debug_mode = false;
 	static int verbose_mode = false;
 	static int interactive_mode = false;
+	static int perf_map_mode = false;
+	static int jitdump_mode = false;
+	
+	const char* profile_path = NULL;
 	
 	ObjectPtr<Array> require_files = create_array();
 	
@@ -95,12 +101,15 @@ int main(int argc, char* const* argv) {
 			{"require",     required_argument, NULL,              'r'},
 			{"interactive", no_argument,       &interactive_mode,  1 },
 			{"verbose",     no_argument,       &verbose_mode,      1 },
+			{"perf-map",    no_argument,       &perf_map_mode,     1 },
+			{"jitdump",     no_argument,       &jitdump_mode,      1 },
+			{"profile",     required_argument, NULL,              'p'},
 			{0,0,0,0}
 		};
 		
 		int option_index = -1;
 		
-		c = getopt_long(argc, argv, "dvir:", long_options, &option_index);
+		c = getopt_long(argc, argv, "dvir:p:", long_options, &option_index);
 		if (c < 0)
 			break;
 		
@@ -122,6 +131,11 @@ int main(int argc, char* const* argv) {
 				interactive_mode = true;
 				break;
 			}
+			case 'p':
+			{
+				profile_path = optarg;
+				break;
+			}
 			case '?':
 				TRAP(); // unknown argument
 			default:
@@ -129,6 +143,12 @@ int main(int argc, char* const* argv) {
 		}
 	}
 	
+	if (perf_map_mode || jitdump_mode) {
+		if (!CodeManager::get()->enable_perf_map(jitdump_mode)) {
+			fprintf(stderr, "WARNING: Could not write perf map for JIT code.\n");
+		}
+	}
+	
 	// require first loose argument, unless -- was used
 	if (optind < argc && strcmp("--", argv[optind-1]) != 0) {
 		ObjectPtr<String> filename = create_string_constant(argv[optind++]);
@@ -143,6 +163,11 @@ int main(int argc, char* const* argv) {
 	}
 	set_global(snow::sym("ARGV"), ARGV);
 	
+	if (profile_path && !profiler_start()) {
+		fprintf(stderr, "WARNING: Could not start profiler.\n");
+		profile_path = NULL;
+	}
+	
 	for (size_t i = 0; i < array_size(require_files); ++i) {
 		ObjectPtr<String> str = array_get(require_files, i);
 		ASSERT(str != NULL);
@@ -153,6 +178,13 @@ int main(int argc, char* const* argv) {
 		interactive_prompt();
 	}
 	
+	if (profile_path) {
+		profiler_stop();
+		if (!profiler_write_folded_stacks(profile_path)) {
+			fprintf(stderr, "ERROR: Could not write profile to %s.\n", profile_path);
+		}
+	}
+	
 	return 0;
 }
 }
\ No newline at end of file
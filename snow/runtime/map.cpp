@@ -104,7 +104,7 @@ namespace snow {
 			SN_STACK_ARRAY(KeyValuePair, pairs, sz);
 			snow::map_get_pairs(s, pairs, sz);
 			for (size_t i = 0; i < sz; ++i) {
-				call(it, NULL, 2, pairs[i].pair);
+				if (call(it, NULL, 2, pairs[i].pair) == SN_UNWINDING) return SN_UNWINDING;
 			}
 			return SN_NIL;
 		}
@@ -154,7 +154,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_map_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("Map"), get_type<Map>());
 			SN_DEFINE_METHOD(cls, "initialize", bindings::map_initialize);
@@ -16,6 +16,7 @@
 
 #include "codemanager.hpp"
 #include "function-internal.hpp"
+#include "isolate-internal.hpp"
 
 namespace snow {
 	namespace {
@@ -27,6 +28,8 @@ namespace snow {
 			void* snomo;
 			// AST?
 			
+			// The compiled code stays with the CodeManager: functions created by the
+			// module point into it and may outlive the module.
 			Module() : snomo(NULL) {}
 			~Module() {
 				if (snomo != NULL) {
@@ -42,21 +45,32 @@ namespace snow {
 			ModuleTypeSource,
 			ModuleTypeDynamicLibrary
 		};
-
+	}
+	
+	// Modules loaded into an isolate. The same file loaded in two isolates is two separate modules.
+	struct ModuleRegistry {
+		ModuleMap map;
+		ModuleList list;
+		
+		ModuleRegistry() {
+			map.set_deleted_key("<DELETED KEY>");
+			map.set_empty_key("");
+		}
+	};
+	
+	namespace {
+		ModuleRegistry& get_module_registry() {
+			Isolate& isolate = current_isolate();
+			if (!isolate.modules) isolate.modules = new ModuleRegistry;
+			return *isolate.modules;
+		}
+		
 		ModuleMap* get_module_map() {
-			static ModuleMap* l = NULL;
-			if (!l) {
-				l = new ModuleMap;
-				l->set_deleted_key("<DELETED KEY>");
-				l->set_empty_key("");
-			}
-			return l;
+			return &get_module_registry().map;
 		}
 
 		ModuleList* get_module_list() {
-			static ModuleList* l = NULL;
-			if (!l) l = new ModuleList;
-			return l;
+			return &get_module_registry().list;
 		}
 
 		bool module_is_loaded(const std::string& full_path, Module*& module) {
@@ -175,7 +189,7 @@ namespace snow {
 
 					// Call module entry
 					Value result = snow::call_with_arguments(m->entry, nullptr, Arguments());
-					object_set_instance_variable(mod, snow::sym("__module_value__"), result);
+					object_set_instance_variable(mod, SN_SYM(__module_value__), result);
 					return m;
 				}
 			}
@@ -226,7 +240,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Array> get_load_paths() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Array> load_paths = create_array_with_size(10);
 			array_push(load_paths, create_string_constant("./"));
@@ -237,7 +251,7 @@ namespace snow {
 	}
 	
 	Value get_global_module() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			Value global_module = create_object(get_object_class(), 0, NULL);
 			object_give_meta_class(global_module);
@@ -283,7 +297,7 @@ namespace snow {
 			ASSERT(get_module_type(path) == ModuleTypeSource); // only source modules are supported in load_in_global_module
 			Value mod = get_global_module();
 			if (compile_module(path, load_source(file), mod)) {
-				return object_get_instance_variable(mod, snow::sym("__module_value__"));
+				return object_get_instance_variable(mod, SN_SYM(__module_value__));
 			} else {
 				fprintf(stderr, "ERROR: Could not compile module: %s\n", path.c_str());
 				return NULL;
@@ -301,7 +315,7 @@ namespace snow {
 		Value mod = get_global_module();
 		Module* module = compile_module("<eval>", source, mod);
 		if (module) {
-			return object_get_instance_variable(mod, snow::sym("__module_value__"));
+			return object_get_instance_variable(mod, SN_SYM(__module_value__));
 		} else {
 			return NULL;
 		}
@@ -16,7 +16,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_nil_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Nil"), NULL);
 			SN_DEFINE_METHOD(cls, "inspect", nil_inspect);
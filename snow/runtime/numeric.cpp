@@ -180,7 +180,7 @@ static VALUE numeric_inspect(const CallFrame* here, VALUE self, VALUE it) {
 
 namespace snow {
 	ObjectPtr<Class> get_numeric_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Numeric"), NULL);
 			SN_DEFINE_METHOD(cls, "+", numeric_add);
@@ -199,7 +199,7 @@ namespace snow {
 	}
 
 	ObjectPtr<Class> get_float_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Float"), get_numeric_class());
 			root = gc_create_root(cls);
@@ -208,7 +208,7 @@ namespace snow {
 	}
 
 	ObjectPtr<Class> get_integer_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Integer"), get_numeric_class());
 			SN_DEFINE_METHOD(cls, "%", integer_modulo);
@@ -138,7 +138,7 @@ namespace snow {
 	}
 	
 	ObjectPtr<Class> get_object_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Object"), NULL);
 			root = gc_create_root(cls);
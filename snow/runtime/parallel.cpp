@@ -0,0 +1,235 @@
+#include "parallel.hpp"
+#include "internal.h"
+#include "isolate-internal.hpp"
+#include "snow/array.hpp"
+#include "snow/channel.hpp"
+#include "snow/exception.hpp"
+#include "snow/fiber.hpp"
+#include "snow/function.hpp"
+#include "snow/isolate.hpp"
+#include "snow/module.hpp"
+#include "snow/numeric.hpp"
+#include "snow/snow.hpp"
+#include "snow/str.hpp"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+namespace snow {
+	namespace {
+		VALUE parallel_task_main(const CallFrame* here, VALUE self, VALUE it) {
+			ObjectPtr<Array> task = self; // @(functor, index, results channel)
+			Value message[] = { array_get(task, 1), SN_NIL, SN_NIL }; // @(index, result, exception)
+			try {
+				message[1] = call_frame_forbid_unwind(call(array_get(task, 0), NULL, 0, NULL), "parallel");
+			}
+			catch (ExceptionPtr ex) {
+				// Nothing above a spawned fiber catches it, so hand it to parallel_thread.
+				message[2] = ex;
+			}
+			channel_send(array_get(task, 2), create_array_from_range(message, message + 3));
+			return SN_NIL;
+		}
+		
+		struct Join {
+			ObjectPtr<Channel> channel;
+			size_t num_functors;
+		};
+		
+		bool join_is_complete(void* data) {
+			const Join* join = static_cast<const Join*>(data);
+			return channel_size(join->channel) >= join->num_functors;
+		}
+		
+		ObjectPtr<Array> create_result_array(size_t size) {
+			ObjectPtr<Array> results = create_array_with_size(size);
+			for (size_t i = 0; i < size; ++i) {
+				array_push(results, SN_NIL);
+			}
+			return results;
+		}
+		
+		bool write_all(int fd, const char* data, size_t size) {
+			while (size > 0) {
+				ssize_t n = ::write(fd, data, size);
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					return false;
+				}
+				data += n;
+				size -= n;
+			}
+			return true;
+		}
+		
+		bool read_all(int fd, std::vector<char>& out) {
+			char buffer[4096];
+			while (true) {
+				ssize_t n = ::read(fd, buffer, sizeof(buffer));
+				if (n == 0) return true;
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					return false;
+				}
+				out.insert(out.end(), buffer, buffer + n);
+			}
+		}
+		
+		// Exit statuses of a forked child. When it raised, the pipe carries the exception text instead of a result.
+		enum ChildStatus {
+			ChildSucceeded = 0,
+			ChildFailed = 1,
+			ChildRaised = 2,
+		};
+		
+		void run_forked_child(Value marshal, Value functor, int fd) {
+			std::string error;
+			try {
+				Value result = call_frame_forbid_unwind(call(functor, NULL, 0, NULL), "parallel");
+				static const Symbol store = snow::sym("store");
+				ObjectPtr<String> data = call_method(marshal, store, 1, &result);
+				size_t size = string_size(data);
+				std::vector<char> buffer(size);
+				string_copy_to(data, buffer.data(), size);
+				_exit(write_all(fd, buffer.data(), size) ? ChildSucceeded : ChildFailed);
+			}
+			catch (ExceptionPtr ex) {
+				try {
+					ObjectPtr<String> description = value_to_string(ex);
+					error.resize(string_size(description));
+					error.resize(string_copy_to(description, &error[0], error.size()));
+				}
+				catch (...) {
+					error = "(exception could not be converted to a string)";
+				}
+			}
+			catch (...) {
+				error = "(unknown exception)";
+			}
+			_exit(write_all(fd, error.data(), error.size()) ? ChildRaised : ChildFailed);
+		}
+		
+		struct Child {
+			pid_t pid;
+			int fd;
+		};
+		
+		void abandon_children(const std::vector<Child>& children) {
+			for (const Child& child: children) {
+				kill(child.pid, SIGKILL);
+				close(child.fd);
+				while (waitpid(child.pid, NULL, 0) < 0 && errno == EINTR);
+			}
+		}
+	}
+	
+	Value parallel_thread(const Value* functors, size_t num_functors) {
+		bool scheduled = fiber_is_scheduled(get_current_fiber());
+		if (!scheduled && fiber_scheduler_is_running()) {
+			// The scheduler is further up this stack, and only returns to it when this fiber yields.
+			throw_exception_with_description("parallel: Cannot wait for operands in a fiber resumed by hand while the fiber scheduler is running.");
+		}
+		
+		ObjectPtr<Channel> channel = create_channel();
+		static const Symbol parallel_task = snow::sym("parallel_task");
+		Value task_main = create_function(parallel_task_main, parallel_task);
+		for (size_t i = 0; i < num_functors; ++i) {
+			Value task[] = { functors[i], integer_to_value((int)i), channel };
+			fiber_spawn(create_bound_method(create_array_from_range(task, task + 3), task_main));
+		}
+		
+		// Outside of the scheduler, run it here until the operands are done. Other queued
+		// fibers may take turns meanwhile, but whatever is left waits for the next run.
+		if (!scheduled) {
+			Join join = { channel, num_functors };
+			fiber_run_scheduler_until(join_is_complete, &join);
+		}
+		
+		// Join every operand before rethrowing, so none is left running.
+		ObjectPtr<Array> results = create_result_array(num_functors);
+		ExceptionPtr failure;
+		int32_t failed_index = (int32_t)num_functors;
+		for (size_t i = 0; i < num_functors; ++i) {
+			ObjectPtr<Array> message = channel_receive(channel);
+			int32_t index = value_to_integer(array_get(message, 0));
+			array_set(results, index, array_get(message, 1));
+			ExceptionPtr ex = array_get(message, 2);
+			if (ex != nullptr && index < failed_index) {
+				failure = ex;
+				failed_index = index;
+			}
+		}
+		if (failure != nullptr) throw_exception(failure);
+		return results;
+	}
+	
+	Value parallel_fork(const Value* functors, size_t num_functors) {
+		if (isolate_count() > 1) {
+			// Another isolate's thread may hold a runtime lock (the block pool, the symbol
+			// table) at the moment of the fork, and the child would never see it released.
+			throw_exception_with_description("parallel: Cannot fork a process running more than one isolate.");
+		}
+		
+		Value marshal = import(create_string_constant("marshal"));
+		
+		std::vector<Child> children;
+		children.reserve(num_functors);
+		
+		fflush(NULL); // or buffered output is written once per child
+		for (size_t i = 0; i < num_functors; ++i) {
+			int fds[2];
+			if (pipe(fds) != 0) {
+				int err = errno;
+				abandon_children(children);
+				throw_exception_with_description("parallel: pipe(): %@", strerror(err));
+			}
+			pid_t pid = fork();
+			if (pid < 0) {
+				int err = errno;
+				close(fds[0]);
+				close(fds[1]);
+				abandon_children(children);
+				throw_exception_with_description("parallel: fork(): %@", strerror(err));
+			}
+			if (pid == 0) {
+				close(fds[0]);
+				run_forked_child(marshal, functors[i], fds[1]);
+			}
+			close(fds[1]);
+			children.push_back((Child){ pid, fds[0] });
+		}
+		
+		// Collect everything before reporting errors, so no child is left behind.
+		std::vector<std::vector<char>> outputs(num_functors);
+		std::vector<int> statuses(num_functors);
+		for (size_t i = 0; i < num_functors; ++i) {
+			SafeRegion blocking;
+			bool read_ok = read_all(children[i].fd, outputs[i]);
+			close(children[i].fd);
+			int status = 0;
+			while (waitpid(children[i].pid, &status, 0) < 0 && errno == EINTR);
+			statuses[i] = read_ok && WIFEXITED(status) ? WEXITSTATUS(status) : ChildFailed;
+		}
+		
+		static const Symbol load = snow::sym("load");
+		ObjectPtr<Array> results = create_result_array(num_functors);
+		for (size_t i = 0; i < num_functors; ++i) {
+			if (statuses[i] == ChildRaised) {
+				std::string error(outputs[i].begin(), outputs[i].end());
+				throw_exception_with_description("parallel: Operand %@ raised an exception in child process %@: %@", (int64_t)i, (int64_t)children[i].pid, error.c_str());
+			}
+			if (statuses[i] != ChildSucceeded) {
+				throw_exception_with_description("parallel: Operand %@ failed in child process %@.", (int64_t)i, (int64_t)children[i].pid);
+			}
+			Value data = create_string_with_size(outputs[i].data(), outputs[i].size());
+			array_set(results, (int32_t)i, call_method(marshal, load, 1, &data));
+		}
+		return results;
+	}
+}
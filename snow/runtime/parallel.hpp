@@ -0,0 +1,38 @@
+#pragma once
+#ifndef PARALLEL_HPP_H3VQ8NPD
+#define PARALLEL_HPP_H3VQ8NPD
+
+#include "snow/basic.h"
+#include "snow/value.hpp"
+
+namespace snow {
+	/*
+		Fork-join evaluation behind the parallel operators. The parser turns
+		`a || b` into __parallel_thread__({ a }, { b }) and `a ||| b` into
+		__parallel_fork__({ a }, { b }). Both call every functor without
+		arguments and return an array of the results, in operand order.
+		
+		parallel_thread runs each functor in its own fiber on the scheduler, so
+		operands that wait (on IO, channels, timers) overlap. The runtime has a
+		single mutator thread, so CPU-bound operands still take turns. Called
+		outside of the scheduler, it runs the scheduler only until its operands
+		are done; other queued fibers may take turns meanwhile, and the rest
+		wait for the next run. It refuses to run in a fiber resumed by hand
+		while the scheduler is running, because that fiber cannot switch to it.
+		
+		parallel_fork runs each functor in a child process, which does use all
+		cores. Results travel back over a pipe in the format of the marshal
+		module, so they are limited to what it can serialize.
+		
+		If an operand throws, the exception is rethrown from the operator once
+		every operand has finished (the first one in operand order, if several
+		throw). A child process cannot send the exception object back, so
+		parallel_fork raises a new one carrying its text. parallel_fork
+		refuses to run while more than one isolate exists, because other
+		threads may hold runtime locks across the fork.
+	*/
+	Value parallel_thread(const Value* functors, size_t num_functors);
+	Value parallel_fork(const Value* functors, size_t num_functors);
+}
+
+#endif /* end of include guard: PARALLEL_HPP_H3VQ8NPD */
@@ -85,6 +85,7 @@ namespace snow {
 		bool skip_end_of_statement(Pos&);
 		
 		ASTNode* reduce_operation(ASTNode* a, ASTNode* b, Pos op);
+		ASTNode* reduce_parallel_operation(ASTNode* a, ASTNode* b, Pos op, ASTNode* open_parallel_call);
 	private:
 		class PrecedenceParser;
 		friend class PrecedenceParser;
@@ -102,8 +103,9 @@ namespace snow {
 		Parser* parser;
 		std::vector<Op> operators;
 		std::vector<ASTNode*> operands;
+		ASTNode* open_parallel_call; // the last parallel operation reduced here, so `a || b || c` becomes one call
 		
-		PrecedenceParser(Parser* parser, ASTNode* first) : parser(parser) {
+		PrecedenceParser(Parser* parser, ASTNode* first) : parser(parser), open_parallel_call(NULL) {
 			operands.push_back(first);
 			operators.push_back(Op(Token::INVALID, Parser::Pos()));
 		}
@@ -126,7 +128,13 @@ namespace snow {
 			Parser::Pos op = operators.back().second;
 			operators.pop_back();
 			
-			ASTNode* reduced = parser->reduce_operation(a, b, op);
+			ASTNode* reduced;
+			if (op->type == Token::PARALLEL_THREAD || op->type == Token::PARALLEL_FORK) {
+				reduced = parser->reduce_parallel_operation(a, b, op, open_parallel_call);
+				open_parallel_call = reduced;
+			} else {
+				reduced = parser->reduce_operation(a, b, op);
+			}
 			operands.push_back(reduced);
 		}
 		
@@ -145,14 +153,20 @@ namespace snow {
 			case Token::LOG_AND:
 			case Token::LOG_OR:
 			case Token::LOG_XOR:
+			case Token::PARALLEL_THREAD:
+			case Token::PARALLEL_FORK:
 				return true;
 			default: return false;
 		}
 	}
 	
+	static inline bool is_unary_operator(Token::Type t) {
+		return (is_operator(t) && t != Token::PARALLEL_THREAD && t != Token::PARALLEL_FORK) || t == Token::LOG_NOT;
+	}
+	
 	
 	static inline const char* position_to_cstr(const std::string& path, const Parser::Pos& pos) {
-		static char* data = NULL;
+		static __thread char* data = NULL; // parsers may run on several isolates at once
 		free(data);
 		asprintf(&data, "%s:%d:%d (%s)", path.c_str(), pos->location.line, pos->location.column, get_token_name(pos->type));
 		return data;
@@ -330,7 +344,7 @@ namespace snow {
 	ASTNode* Parser::operand_with_unary(Pos& pos) {
 		Pos p = pos;
 		Token::Type type = p->type;
-		if (is_operator(type) || type == Token::LOG_NOT) {
+		if (is_unary_operator(type)) {
 			GET_TOKEN_SZ(data, p);
 			++p;
 			ASTNode* a = operand(p);
@@ -402,13 +416,26 @@ namespace snow {
 	
 	ASTNode* Parser::lvalue(Pos& pos) {
 		/*
-			lvalue := association | instance_variable | identifier | method;
+			lvalue := association | instance_variable | identifier (AS identifier)? | method;
 			
 			TODO:
 			lvalue := chain_that_doesnt_end_with_call | identifier;
 		*/
 		ASTNode* result = chain(pos);
-		if (result) MATCH_SUCCESS(result);
+		if (result) {
+			if (result->type == ASTNodeTypeIdentifier && pos->type == Token::AS) {
+				Pos p = pos;
+				++p;
+				ASTNode* type_id = identifier(p);
+				if (!type_id) {
+					error(p, "Expected type identifier for AS keyword, got %s.", get_token_name(p->type));
+					MATCH_FAILED();
+				}
+				result->identifier.id_type = type_id;
+				pos = p;
+			}
+			MATCH_SUCCESS(result);
+		}
 		MATCH_FAILED();
 	}
 	
@@ -1052,6 +1079,24 @@ namespace snow {
 		}
 	}
 	
+	ASTNode* Parser::reduce_parallel_operation(ASTNode* a, ASTNode* b, Pos op, ASTNode* open_parallel_call) {
+		/*
+			Every operand becomes a closure, and the whole chain one call:
+			a || b || c  =>  __parallel_thread__({ a }, { b }, { c })
+			a ||| b      =>  __parallel_fork__({ a }, { b })
+			Parenthesized operations are reduced by their own PrecedenceParser,
+			so (a || b) || c still nests.
+		*/
+		Symbol name = snow::sym(op->type == Token::PARALLEL_THREAD ? "__parallel_thread__" : "__parallel_fork__");
+		ASTNode* right = ast->closure(op->location, NULL, ast->sequence(1, b));
+		if (a == open_parallel_call && a->call.object->identifier.name == name) {
+			ast->sequence_push(a->call.args, right);
+			return a;
+		}
+		ASTNode* left = ast->closure(op->location, NULL, ast->sequence(1, a));
+		return ast->call(op->location, ast->identifier(op->location, name), ast->sequence(2, left, right));
+	}
+	
 	ASTBase* parse(const std::string& path, const std::string& source) {
 		Lexer l(path, source.c_str());
 		l.tokenize();
@@ -0,0 +1,215 @@
+#include "perfmap.hpp"
+#include "codemanager.hpp"
+#include "internal.h"
+
+#include <atomic>
+#include <string>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace snow {
+	namespace {
+		// See tools/perf/Documentation/jitdump-specification.txt in the Linux tree.
+		static const uint32_t JITDUMP_MAGIC = 0x4A695444;
+		static const uint32_t JITDUMP_VERSION = 1;
+		static const uint32_t JITDUMP_ELF_MACHINE = 62; // EM_X86_64
+		
+		enum JitdumpRecordType {
+			JIT_CODE_LOAD = 0,
+			JIT_CODE_DEBUG_INFO = 2,
+		};
+		
+		struct JitdumpHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t total_size;
+			uint32_t elf_mach;
+			uint32_t pad1;
+			uint32_t pid;
+			uint64_t timestamp;
+			uint64_t flags;
+		} SN_PACKED;
+		
+		struct JitdumpRecordHeader {
+			uint32_t id;
+			uint32_t total_size;
+			uint64_t timestamp;
+		} SN_PACKED;
+		
+		struct JitdumpCodeLoad {
+			JitdumpRecordHeader header;
+			uint32_t pid;
+			uint32_t tid;
+			uint64_t vma;
+			uint64_t code_addr;
+			uint64_t code_size;
+			uint64_t code_index;
+			// followed by: name (NUL-terminated), code
+		} SN_PACKED;
+		
+		struct JitdumpDebugInfo {
+			JitdumpRecordHeader header;
+			uint64_t code_addr;
+			uint64_t nr_entry;
+			// followed by nr_entry entries
+		} SN_PACKED;
+		
+		struct JitdumpDebugEntry {
+			uint64_t code_addr;
+			uint32_t line;
+			uint32_t discrim;
+			// followed by: file name (NUL-terminated)
+		} SN_PACKED;
+		
+		inline uint64_t timestamp() {
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+		}
+		
+		inline uint32_t thread_id() {
+			#if defined(__linux__)
+			return (uint32_t)syscall(SYS_gettid);
+			#else
+			return (uint32_t)getpid();
+			#endif
+		}
+		
+		inline std::string function_name(const CodeModule& module, const CodeFunction& function) {
+			std::string name = function.name ? sym_to_cstr(function.name) : "<anonymous>";
+			return name + " [" + module.source_file.path + "]";
+		}
+		
+		std::mutex perf_map_enable_lock;
+		std::atomic<PerfMap*> perf_map_instance(NULL);
+	}
+	
+	bool PerfMap::enable(bool with_jitdump) {
+		std::lock_guard<std::mutex> guard(perf_map_enable_lock);
+		if (perf_map_instance.load(std::memory_order_relaxed) != NULL) return true;
+		PerfMap* perf_map = new PerfMap;
+		if (!perf_map->open(with_jitdump)) {
+			delete perf_map;
+			return false;
+		}
+		perf_map_instance.store(perf_map, std::memory_order_release); // lives until exit
+		return true;
+	}
+	
+	PerfMap* PerfMap::get() {
+		return perf_map_instance.load(std::memory_order_acquire);
+	}
+	
+	PerfMap::~PerfMap() {
+		if (_map) fclose(_map);
+		if (_jitdump_marker) munmap(_jitdump_marker, SN_MEMORY_PAGE_SIZE);
+		if (_jitdump) fclose(_jitdump);
+	}
+	
+	bool PerfMap::open(bool with_jitdump) {
+		char path[64];
+		snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+		_map = fopen(path, "w");
+		if (_map == NULL) return false;
+		setvbuf(_map, NULL, _IOLBF, 0); // perf may read the file while we're still running
+		return with_jitdump ? open_jitdump() : true;
+	}
+	
+	bool PerfMap::open_jitdump() {
+		char path[64];
+		snprintf(path, sizeof(path), "/tmp/jit-%d.dump", getpid());
+		int fd = ::open(path, O_CREAT|O_TRUNC|O_RDWR, 0666);
+		if (fd < 0) return false;
+		
+		// perf finds the dump through an executable mapping of the file in the
+		// recorded process, so this mapping must exist even though it is unused.
+		_jitdump_marker = mmap(NULL, SN_MEMORY_PAGE_SIZE, PROT_READ|PROT_EXEC, MAP_PRIVATE, fd, 0);
+		if (_jitdump_marker == MAP_FAILED) {
+			_jitdump_marker = NULL;
+			close(fd);
+			return false;
+		}
+		
+		_jitdump = fdopen(fd, "wb");
+		JitdumpHeader header;
+		header.magic = JITDUMP_MAGIC;
+		header.version = JITDUMP_VERSION;
+		header.total_size = sizeof(header);
+		header.elf_mach = JITDUMP_ELF_MACHINE;
+		header.pad1 = 0;
+		header.pid = getpid();
+		header.timestamp = timestamp();
+		header.flags = 0;
+		fwrite(&header, sizeof(header), 1, _jitdump);
+		fflush(_jitdump);
+		return true;
+	}
+	
+	void PerfMap::write_module(const CodeModule& module) {
+		std::lock_guard<std::mutex> guard(_lock);
+		for (size_t i = 0; i < module.functions.size(); ++i) {
+			const CodeFunction& function = module.functions[i];
+			std::string name = function_name(module, function);
+			if (_map) {
+				fprintf(_map, "%lx %x %s\n", (unsigned long)(module.memory + function.code_offset), function.code_length, name.c_str());
+			}
+			if (_jitdump) {
+				write_jitdump_code_load(module, i, name.c_str());
+			}
+		}
+		if (_jitdump) fflush(_jitdump);
+	}
+	
+	void PerfMap::write_jitdump_code_load(const CodeModule& module, size_t function_index, const char* name) {
+		const CodeFunction& function = module.functions[function_index];
+		const byte* code = module.memory + function.code_offset;
+		const char* file_name = module.source_file.path.c_str();
+		
+		// The debug info record must precede the code load record it describes.
+		auto begin = module.locations.begin();
+		auto end = module.locations.end();
+		while (begin != end && begin->code_offset < function.code_offset) ++begin;
+		auto last = begin;
+		while (last != end && last->code_offset < function.code_offset + function.code_length) ++last;
+		
+		if (begin != last) {
+			size_t num_entries = last - begin;
+			size_t file_name_size = strlen(file_name) + 1;
+			JitdumpDebugInfo info;
+			info.header.id = JIT_CODE_DEBUG_INFO;
+			info.header.total_size = sizeof(info) + num_entries * (sizeof(JitdumpDebugEntry) + file_name_size);
+			info.header.timestamp = timestamp();
+			info.code_addr = (uint64_t)code;
+			info.nr_entry = num_entries;
+			fwrite(&info, sizeof(info), 1, _jitdump);
+			for (auto it = begin; it != last; ++it) {
+				JitdumpDebugEntry entry;
+				entry.code_addr = (uint64_t)(module.memory + it->code_offset);
+				entry.line = it->line;
+				entry.discrim = 0;
+				fwrite(&entry, sizeof(entry), 1, _jitdump);
+				fwrite(file_name, file_name_size, 1, _jitdump);
+			}
+		}
+		
+		size_t name_size = strlen(name) + 1;
+		JitdumpCodeLoad load;
+		load.header.id = JIT_CODE_LOAD;
+		load.header.total_size = sizeof(load) + name_size + function.code_length;
+		load.header.timestamp = timestamp();
+		load.pid = getpid();
+		load.tid = thread_id();
+		load.vma = (uint64_t)code;
+		load.code_addr = (uint64_t)code;
+		load.code_size = function.code_length;
+		load.code_index = _code_index++;
+		fwrite(&load, sizeof(load), 1, _jitdump);
+		fwrite(name, name_size, 1, _jitdump);
+		fwrite(code, function.code_length, 1, _jitdump);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef PERFMAP_HPP_HV7N3QLC
+#define PERFMAP_HPP_HV7N3QLC
+
+#include "snow/basic.h"
+
+#include <mutex>
+
+namespace snow {
+	struct CodeModule;
+	
+	/*
+		Writes symbol information for JIT code in the formats understood by
+		Linux perf:
+		
+		- /tmp/perf-<pid>.map: one "<start> <size> <name>" line per function.
+		- /tmp/jit-<pid>.dump: the jitdump format, which also carries a copy of
+		  the code and line tables. Use with `perf record -k 1` and
+		  `perf inject --jit`.
+		
+		perf finds both files by pid, so there is one PerfMap per process,
+		shared by every isolate. Writes are locked.
+	*/
+	class PerfMap {
+	public:
+		static bool enable(bool with_jitdump); // false if the files could not be opened
+		static PerfMap* get(); // NULL until enabled
+		
+		void write_module(const CodeModule& module);
+	private:
+		PerfMap() : _map(NULL), _jitdump(NULL), _jitdump_marker(NULL), _code_index(0) {}
+		~PerfMap();
+		
+		bool open(bool with_jitdump);
+		bool open_jitdump();
+		void write_jitdump_code_load(const CodeModule& module, size_t function_index, const char* name);
+		
+		FILE* _map;
+		FILE* _jitdump;
+		void* _jitdump_marker;
+		uint64_t _code_index;
+		std::mutex _lock;
+	};
+}
+
+#endif /* end of include guard: PERFMAP_HPP_HV7N3QLC */
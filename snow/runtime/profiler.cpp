@@ -0,0 +1,172 @@
+#include "profiler.hpp"
+#include "internal.h"
+#include "codemanager.hpp"
+#include "fiber-internal.hpp"
+#include "snow/fiber.hpp"
+#include "snow/function.hpp"
+
+#include <atomic>
+#include <map>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+namespace snow {
+	namespace {
+		static const size_t MAX_SAMPLES = 1 << 15;
+		static const size_t MAX_SAMPLE_DEPTH = 64;
+		
+		struct Sample {
+			void* ip;
+			uint32_t depth;
+			bool truncated;
+			Symbol names[MAX_SAMPLE_DEPTH]; // innermost first
+		};
+		
+		struct Profiler {
+			Sample* samples;
+			std::atomic<size_t> num_samples;
+			std::atomic<size_t> num_dropped;
+			bool running;
+			struct sigaction previous_action;
+			
+			Profiler() : samples(NULL), num_samples(0), num_dropped(0), running(false) {}
+		};
+		
+		static Profiler profiler;
+		
+		inline void* interrupted_ip(void* ucontext) {
+			ucontext_t* uc = (ucontext_t*)ucontext;
+			#if defined(__APPLE__)
+			return (void*)uc->uc_mcontext->__ss.__rip;
+			#elif defined(__linux__)
+			return (void*)uc->uc_mcontext.gregs[REG_RIP];
+			#else
+			return NULL;
+			#endif
+		}
+		
+		void profiler_signal_handler(int sig, siginfo_t* info, void* ucontext) {
+			// Async-signal context: no allocation, no locks, no symbolization.
+			size_t idx = profiler.num_samples.fetch_add(1);
+			if (idx >= MAX_SAMPLES) {
+				profiler.num_samples = MAX_SAMPLES;
+				++profiler.num_dropped;
+				return;
+			}
+			
+			Sample& sample = profiler.samples[idx];
+			sample.ip = interrupted_ip(ucontext);
+			sample.depth = 0;
+			sample.truncated = false;
+			
+			const CallFrame* frame = fiber_get_current_frame_in_signal_handler();
+			while (frame) {
+				if (sample.depth == MAX_SAMPLE_DEPTH) {
+					sample.truncated = true;
+					break;
+				}
+				sample.names[sample.depth++] = frame->function != NULL ? function_get_name(frame->function) : 0;
+				frame = frame->caller;
+			}
+		}
+		
+		inline const char* frame_name(Symbol name) {
+			return name ? sym_to_cstr(name) : "<anonymous>";
+		}
+	}
+	
+	bool profiler_start(unsigned int frequency_hz) {
+		if (profiler.running) return true;
+		if (frequency_hz == 0 || frequency_hz > SN_PROFILER_MAX_FREQUENCY_HZ) return false;
+		
+		if (profiler.samples == NULL) {
+			profiler.samples = new Sample[MAX_SAMPLES];
+		}
+		profiler.num_samples = 0;
+		profiler.num_dropped = 0;
+		
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = profiler_signal_handler;
+		action.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGPROF, &action, &profiler.previous_action) < 0) {
+			return false;
+		}
+		
+		// setitimer rather than timer_create, which Darwin does not have.
+		struct itimerval timer;
+		timer.it_interval.tv_sec = 0;
+		timer.it_interval.tv_usec = 1000000 / frequency_hz;
+		timer.it_value = timer.it_interval;
+		if (setitimer(ITIMER_PROF, &timer, NULL) < 0) {
+			sigaction(SIGPROF, &profiler.previous_action, NULL);
+			return false;
+		}
+		profiler.running = true;
+		return true;
+	}
+	
+	void profiler_stop() {
+		if (!profiler.running) return;
+		struct itimerval timer;
+		memset(&timer, 0, sizeof(timer));
+		setitimer(ITIMER_PROF, &timer, NULL);
+		sigaction(SIGPROF, &profiler.previous_action, NULL);
+		profiler.running = false;
+	}
+	
+	bool profiler_is_running() {
+		return profiler.running;
+	}
+	
+	size_t profiler_num_samples() {
+		size_t n = profiler.num_samples;
+		return n < MAX_SAMPLES ? n : MAX_SAMPLES;
+	}
+	
+	std::string profiler_get_folded_stacks() {
+		// Merging identical stacks is the same as building the call tree and
+		// listing its leaves, which is all a flame graph needs.
+		std::map<std::string, size_t> stacks;
+		size_t n = profiler_num_samples();
+		for (size_t i = 0; i < n; ++i) {
+			const Sample& sample = profiler.samples[i];
+			std::string stack = sample.truncated ? "<truncated>" : "";
+			for (size_t j = sample.depth; j > 0; --j) {
+				if (!stack.empty()) stack += ";";
+				stack += frame_name(sample.names[j-1]);
+			}
+			
+			const SourceFile* file;
+			const SourceLocation* location;
+			if (sample.depth && CodeManager::get()->find_source_location_from_instruction_pointer(sample.ip, file, location)) {
+				char buffer[32];
+				snprintf(buffer, sizeof(buffer), ":%u)", location->line);
+				stack += " (" + file->path + buffer;
+			}
+			if (stack.empty()) stack = "<native>";
+			++stacks[stack];
+		}
+		
+		std::string result;
+		for (auto& pair: stacks) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), " %zu\n", pair.second);
+			result += pair.first + buffer;
+		}
+		return result;
+	}
+	
+	bool profiler_write_folded_stacks(const char* path) {
+		FILE* fp = fopen(path, "w");
+		if (fp == NULL) return false;
+		std::string folded = profiler_get_folded_stacks();
+		bool ok = fwrite(folded.data(), 1, folded.size(), fp) == folded.size();
+		if (profiler.num_dropped) {
+			fprintf(stderr, "WARNING: Profiler buffer was full, %zu samples were dropped.\n", (size_t)profiler.num_dropped);
+		}
+		return fclose(fp) == 0 && ok;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef PROFILER_HPP_ZB3UE7KX
+#define PROFILER_HPP_ZB3UE7KX
+
+#include "snow/basic.h"
+
+#include <string>
+
+namespace snow {
+	/*
+		Sampling profiler driven by SIGPROF. Each sample records the names of
+		the functions on the current fiber's CallFrame chain and the interrupted
+		instruction pointer. Samples are aggregated and symbolized (source line
+		of the innermost JIT frame) when the profile is read, never inside the
+		signal handler.
+		
+		Output is in the "folded stacks" format understood by flamegraph.pl:
+		
+			outer;middle;inner (file.sn:12) 42
+	*/
+	static const unsigned int SN_PROFILER_MAX_FREQUENCY_HZ = 10000; // setitimer can't go much finer
+	
+	bool profiler_start(unsigned int frequency_hz = 1000); // false if the frequency is out of range or the timer could not be set up
+	void profiler_stop();
+	bool profiler_is_running();
+	size_t profiler_num_samples();
+	std::string profiler_get_folded_stacks();
+	bool profiler_write_folded_stacks(const char* path);
+}
+
+#endif /* end of include guard: PROFILER_HPP_ZB3UE7KX */
@@ -0,0 +1,82 @@
+#include "safepoint.hpp"
+#include "internal.h"
+#include "gc-intern.hpp"
+#include "snow/gc.hpp"
+
+namespace snow {
+	const std::atomic<uint8_t>* safepoint_flag() {
+		return &current_isolate().safepoint.requested;
+	}
+
+	void safepoint_park() {
+		SafepointState& state = current_isolate().safepoint;
+		jmp_buf registers;
+		setjmp(registers); // spill callee-saved registers where the collector will see them
+		std::unique_lock<std::mutex> guard(state.lock);
+		if (!state.requested) return; // resumed already
+		state.stack_bottom = (const byte*)&registers;
+		state.mutator = MutatorParked;
+		state.changed.notify_all();
+		state.changed.wait(guard, [&]() { return !state.requested; });
+		state.mutator = MutatorRunning;
+		state.stack_bottom = NULL;
+		guard.unlock();
+		gc_finish_pending_sweep();
+	}
+
+	void safepoint_stop(Isolate* isolate) {
+		ASSERT(isolate != _current_isolate); // would wait for ourselves
+		// Our own isolate counts as stopped while we wait, or two isolates stopping
+		// each other would wait for each other forever.
+		SafeRegion waiting;
+		SafepointState& state = isolate->safepoint;
+		std::unique_lock<std::mutex> guard(state.lock);
+		// Another thread may be stopping it already. Take turns, or both would mark the heap at once.
+		state.changed.wait(guard, [&]() { return !state.requested; });
+		state.requested = 1;
+		state.changed.wait(guard, [&]() { return state.mutator != MutatorRunning; });
+	}
+
+	void safepoint_resume(Isolate* isolate) {
+		SafepointState& state = isolate->safepoint;
+		std::lock_guard<std::mutex> guard(state.lock);
+		ASSERT(state.requested);
+		state.requested = 0;
+		state.changed.notify_all();
+	}
+
+	void isolate_collect_garbage(Isolate* isolate) {
+		if (isolate == _current_isolate) {
+			gc();
+			return;
+		}
+		safepoint_stop(isolate);
+		Isolate* previous = set_current_isolate(isolate);
+		gc_mark(isolate->safepoint.stack_bottom);
+		set_current_isolate(previous);
+		safepoint_resume(isolate); // the isolate sweeps as it resumes, so finalizers run on its own thread
+	}
+
+	SafeRegion::SafeRegion() : _isolate(_current_isolate) {
+		if (_isolate == NULL) return;
+		setjmp(_registers);
+		void* bottom = NULL; // below the caller's frame, so its locals are scanned too
+		SafepointState& state = _isolate->safepoint;
+		std::lock_guard<std::mutex> guard(state.lock);
+		ASSERT(state.mutator == MutatorRunning); // regions don't nest
+		state.stack_bottom = (const byte*)&bottom;
+		state.mutator = MutatorBlocked;
+		state.changed.notify_all();
+	}
+
+	SafeRegion::~SafeRegion() {
+		if (_isolate == NULL) return;
+		SafepointState& state = _isolate->safepoint;
+		std::unique_lock<std::mutex> guard(state.lock);
+		state.changed.wait(guard, [&]() { return !state.requested; });
+		state.mutator = MutatorRunning;
+		state.stack_bottom = NULL;
+		guard.unlock();
+		gc_finish_pending_sweep();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SAFEPOINT_HPP_Q4W8NC1E
+#define SAFEPOINT_HPP_Q4W8NC1E
+
+#include "isolate-internal.hpp"
+
+namespace snow {
+	/*
+		Safepoints let another thread stop an isolate's mutator at a point
+		where its whole state is on its stack, so the heap can be marked (or
+		otherwise inspected) from that thread. Anything that has to happen on
+		the isolate's own thread, like sweeping and running finalizers, is
+		done by the mutator as it resumes, before it touches the heap again.
+	
+		Compiled code polls the isolate's request flag in every function
+		prologue and at every loop back-edge, which is a byte compare against
+		a constant address and a branch that is never taken. Allocation polls
+		too. When the flag is set, the mutator parks in safepoint_park: it
+		spills its callee-saved registers onto the stack, publishes the bottom
+		of its stack, and waits for safepoint_resume. The loop and call polls
+		bound how long a stop has to wait for compiled code.
+	
+		Code that blocks outside of Snow (waiting for IO, sleeping) does so in
+		a SafeRegion (see snow/isolate.hpp). A mutator in a safe region counts
+		as stopped; if a stop is in progress when it leaves the region, it
+		waits for the resume. Anything else a mutator does outside compiled
+		code without a safe region delays a stop until it returns.
+	
+		Threads stopping the same isolate take turns: a stop waits until the
+		one before it has resumed the isolate.
+	*/
+	
+	void safepoint_park(); // the slow path of a poll
+	const std::atomic<uint8_t>* safepoint_flag(); // what compiled code for the current isolate polls
+	
+	inline void safepoint_poll() {
+		if (UNLIKELY(current_isolate().safepoint.requested.load(std::memory_order_relaxed)))
+			safepoint_park();
+	}
+	
+	// Blocks until the isolate is parked or blocked, with the calling thread's own isolate (which
+	// must be a different one) in a safe region meanwhile.
+	void safepoint_stop(Isolate* isolate);
+	void safepoint_resume(Isolate* isolate);
+}
+
+#endif /* end of include guard: SAFEPOINT_HPP_Q4W8NC1E */
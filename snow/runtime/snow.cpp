@@ -8,6 +8,7 @@
 #include "snow/fiber.hpp"
 #include "snow/function.hpp"
 #include "snow/gc.hpp"
+#include "snow/isolate.hpp"
 #include "snow/map.hpp"
 #include "snow/module.hpp"
 #include "snow/nil.hpp"
@@ -32,6 +33,9 @@ namespace snow {
 	void init_fibers();
 	
 	void init(const char* lib_path) {
+		if (get_current_isolate() == NULL) {
+			set_current_isolate(create_isolate());
+		}
 		void* stk;
 		init_gc(&stk);
 		init_fibers();
@@ -136,14 +140,14 @@ namespace snow {
 
 
 	ObjectPtr<String> value_to_string(Value it) {
-		ObjectPtr<String> str = SN_CALL_METHOD(it, "to_string", 0, NULL);
+		ObjectPtr<String> str = call_frame_forbid_unwind(call_method(it, SN_SYM(to_string), 0, NULL), "to_string");
 		ASSERT(str != NULL); // .to_string returned non-String
 		return str;
 	}
 
 	ObjectPtr<String> value_inspect(Value it) {
 		try {
-			ObjectPtr<String> str = SN_CALL_METHOD(it, "inspect", 0, NULL);
+			ObjectPtr<String> str = call_frame_forbid_unwind(call_method(it, SN_SYM(inspect), 0, NULL), "inspect");
 			ASSERT(str != NULL); // .inspect returned non-String
 			return str;
 		}
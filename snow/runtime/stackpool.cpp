@@ -0,0 +1,59 @@
+#include "stackpool.hpp"
+#include "isolate-internal.hpp"
+#include "internal.h"
+
+#include <sys/mman.h>
+
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+namespace snow {
+	namespace {
+		inline void release_pages(byte* memory, size_t size) {
+			#if defined(__APPLE__)
+			madvise(memory, size, MADV_FREE);
+			#else
+			madvise(memory, size, MADV_DONTNEED);
+			#endif
+		}
+	}
+	
+	FiberStackPool::~FiberStackPool() {
+		for (byte* stack: _pool) {
+			munmap(stack - GUARD_SIZE, GUARD_SIZE + STACK_SIZE);
+		}
+	}
+	
+	byte* FiberStackPool::allocate() {
+		if (!_pool.empty()) {
+			byte* stack = _pool.back();
+			_pool.pop_back();
+			return stack;
+		}
+		
+		byte* memory = (byte*)mmap(NULL, GUARD_SIZE + STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+		if (memory == MAP_FAILED) return NULL;
+		if (mprotect(memory, GUARD_SIZE, PROT_NONE) != 0) {
+			munmap(memory, GUARD_SIZE + STACK_SIZE);
+			return NULL;
+		}
+		return memory + GUARD_SIZE;
+	}
+	
+	void FiberStackPool::free(byte* stack) {
+		ASSERT(((uintptr_t)stack & (SN_MEMORY_PAGE_SIZE - 1)) == 0);
+		if (_pool.size() >= MAX_POOLED) {
+			munmap(stack - GUARD_SIZE, GUARD_SIZE + STACK_SIZE);
+			return;
+		}
+		release_pages(stack, STACK_SIZE);
+		_pool.push_back(stack);
+	}
+	
+	FiberStackPool& get_fiber_stack_pool() {
+		Isolate& isolate = current_isolate();
+		if (!isolate.stack_pool) isolate.stack_pool = new FiberStackPool; // never destroyed; fibers may be finalized late
+		return *isolate.stack_pool;
+	}
+}
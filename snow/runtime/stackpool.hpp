@@ -0,0 +1,46 @@
+#pragma once
+#ifndef STACKPOOL_HPP_K7R3DXQ9
+#define STACKPOOL_HPP_K7R3DXQ9
+
+#include "snow/basic.h"
+#include "fiber-internal.hpp"
+
+#include <vector>
+
+namespace snow {
+	/*
+		FiberStackPool hands out fiber stacks and takes them back for reuse, so
+		creating a fiber (e.g. for a generator in a Fiber#each pipeline) does not
+		cost a fresh mapping every time.
+		
+		Each stack is a large reservation of address space with a PROT_NONE guard
+		page below it, so an overflow faults instead of silently running into
+		whatever is mapped next. Pages are committed by the kernel on first touch,
+		so a fiber that only ever uses a few kilobytes of stack only costs that
+		much physical memory. When a stack is returned to the pool, its pages are
+		handed back to the kernel with madvise, keeping the reservation but not
+		the memory.
+		
+		Like the rest of the runtime, the pool is not thread safe.
+	*/
+	class FiberStackPool {
+	public:
+		static const size_t STACK_SIZE = SN_FIBER_STACK_SIZE;
+		static const size_t GUARD_SIZE = SN_MEMORY_PAGE_SIZE;
+		static const size_t MAX_POOLED = 64;
+		
+		FiberStackPool() {}
+		~FiberStackPool();
+		
+		byte* allocate(); // lowest usable address, or NULL; the stack is STACK_SIZE bytes long
+		void free(byte* stack);
+		
+		size_t num_pooled() const { return _pool.size(); }
+	private:
+		std::vector<byte*> _pool;
+	};
+	
+	FiberStackPool& get_fiber_stack_pool();
+}
+
+#endif /* end of include guard: STACKPOOL_HPP_K7R3DXQ9 */
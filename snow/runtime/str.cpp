@@ -250,7 +250,7 @@ namespace snow {
 	}
 
 	ObjectPtr<Class> get_string_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class_for_type(snow::sym("String"), get_type<String>());
 			SN_DEFINE_METHOD(cls, "inspect", bindings::string_inspect);
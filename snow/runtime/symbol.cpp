@@ -5,21 +5,151 @@
 #include "snow/exception.hpp"
 #include "snow/str.hpp"
 
-#include <map>
-#include <string>
+#include <google/dense_hash_map>
+#include <atomic>
+#include <mutex>
 
 namespace snow {
-
-// TODO: Figure out a way to use google::dense_hash_map with -fno-rtti
-	typedef std::map<std::string, Symbol> SymbolTable;
+	namespace {
+		struct HashCString {
+			size_t operator()(const char* str) const {
+				// FNV-1a
+				uint64_t h = 14695981039346656037ULL;
+				for (const byte* p = (const byte*)str; *p; ++p) {
+					h ^= *p;
+					h *= 1099511628211ULL;
+				}
+				return h;
+			}
+		};
+		
+		struct EqualCString {
+			bool operator()(const char* a, const char* b) const {
+				return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+			}
+		};
+		
+		/*
+			Symbol names are never freed, so they are packed into large chunks
+			instead of being allocated one by one.
+		*/
+		class StringArena {
+		public:
+			static const size_t CHUNK_SIZE = 16384;
+			StringArena() : _current(NULL), _remaining(0) {}
+			
+			const char* copy(const char* str, size_t len) {
+				size_t size = len + 1;
+				char* p;
+				if (size > CHUNK_SIZE / 4) {
+					p = new char[size];
+				} else {
+					if (size > _remaining) {
+						_current = new char[CHUNK_SIZE];
+						_remaining = CHUNK_SIZE;
+					}
+					p = _current;
+					_current += size;
+					_remaining -= size;
+				}
+				memcpy(p, str, size);
+				return p;
+			}
+		private:
+			char* _current;
+			size_t _remaining;
+		};
+		
+		/*
+			Names indexed by Symbol. Lookups do not lock: the names are kept in
+			fixed-size chunks that never move once allocated, and a symbol is
+			published by bumping the count only after its name is in place.
+			Appending happens under the symbol table lock.
+		*/
+		class NameList {
+		public:
+			static const size_t CHUNK_SIZE = 4096;
+			static const size_t MAX_CHUNKS = 4096;
+			NameList() : _size(0) {
+				for (auto& chunk: _chunks) chunk.store(NULL, std::memory_order_relaxed);
+			}
+			
+			size_t size() const { return _size.load(std::memory_order_acquire); }
+			
+			const char* get(size_t index) const {
+				ASSERT(index < size());
+				return _chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+			}
+			
+			void push_back(const char* name) {
+				size_t index = _size.load(std::memory_order_relaxed);
+				size_t chunk_index = index / CHUNK_SIZE;
+				if (chunk_index >= MAX_CHUNKS) {
+					throw_exception_with_description("Symbol table is full (%@ symbols).", (int64_t)index);
+				}
+				const char** chunk = _chunks[chunk_index].load(std::memory_order_relaxed);
+				if (chunk == NULL) {
+					chunk = new const char*[CHUNK_SIZE];
+					_chunks[chunk_index].store(chunk, std::memory_order_release);
+				}
+				chunk[index % CHUNK_SIZE] = name;
+				_size.store(index + 1, std::memory_order_release);
+			}
+		private:
+			std::atomic<const char**> _chunks[MAX_CHUNKS];
+			std::atomic<size_t> _size;
+		};
+		
+		static constexpr const char* WELL_KNOWN_SYMBOL_NAMES[] = {
+			#define SN_WELL_KNOWN_SYMBOL_NAME(ID, NAME) NAME,
+			SN_WELL_KNOWN_SYMBOLS(SN_WELL_KNOWN_SYMBOL_NAME)
+			#undef SN_WELL_KNOWN_SYMBOL_NAME
+		};
+		
+		/*
+			Symbols are process-wide, so the same Symbol means the same name in
+			every isolate, and interning is locked. Compiled code has its symbols
+			resolved already, and natives keep theirs in static constants, so the
+			lock is only taken when interning strings at runtime. Turning symbols
+			back into names does not lock, see NameList.
+		*/
+		struct SymbolTable {
+			typedef google::dense_hash_map<const char*, Symbol, HashCString, EqualCString> NameMap;
+			NameMap symbols;
+			NameList names; // names[0] is unused
+			StringArena strings;
+			std::mutex lock;
+			
+			SymbolTable() {
+				names.push_back(NULL);
+				symbols.set_empty_key(NULL);
+				for (const char* name: WELL_KNOWN_SYMBOL_NAMES) {
+					intern_locked(name);
+				}
+				ASSERT(names.size() == well_known_symbols::_end);
+			}
+			
+			Symbol intern(const char* str) {
+				std::lock_guard<std::mutex> guard(lock);
+				return intern_locked(str);
+			}
+			
+			Symbol intern_locked(const char* str) {
+				NameMap::const_iterator it = symbols.find(str);
+				if (it != symbols.end()) {
+					return it->second;
+				}
+				const char* name = strings.copy(str, strlen(str));
+				Symbol sym = names.size();
+				names.push_back(name);
+				symbols[name] = sym;
+				return sym;
+			}
+		};
+	}
 
 	static SymbolTable& symbol_table() {
-		static SymbolTable* t = NULL;
-		if (!t) {
-			t = new SymbolTable;
-		/*t->set_deleted_key(std::string("<DELETED SYMBOL>"));
-		t->set_empty_key(std::string());*/
-		}
+		static SymbolTable* t = new SymbolTable; // initialized once, even with several isolates starting up
 		return *t;
 	}
 
@@ -43,30 +173,19 @@ namespace snow {
 	}
 
 	Symbol sym(const char* str) {
-		SymbolTable& t = symbol_table();
-		std::string s(str);
-		SymbolTable::iterator it = t.find(s);
-		if (it != t.end()) {
-			return it->second;
-		} else {
-			Symbol sym = t.size() + 1;
-			t[s] = sym;
-			return sym;
-		}
+		return symbol_table().intern(str);
 	}
 
 	const char* sym_to_cstr(Symbol sym) {
-		SymbolTable& t = symbol_table();
-		for (SymbolTable::const_iterator it = t.begin(); it != t.end(); ++it) {
-			if (it->second == sym) {
-				return it->first.c_str();
-			}
+		const NameList& names = symbol_table().names;
+		if (LIKELY(sym > 0 && sym < names.size())) {
+			return names.get(sym);
 		}
 		return "<invalid>";
 	}
 
 	ObjectPtr<Class> get_symbol_class() {
-		static Value* root = NULL;
+		static IsolateRoot root;
 		if (!root) {
 			ObjectPtr<Class> cls = create_class(snow::sym("Symbol"), NULL);
 			SN_DEFINE_METHOD(cls, "inspect", bindings::symbol_inspect);
@@ -1,8 +1,12 @@
 #include "codegen-intern.hpp"
 #include "../ccall-bindings.hpp"
 #include "dwarf.hpp"
+#include "../safepoint.hpp"
 
 #include "snow/exception.hpp"
+#include "snow/numeric.hpp"
+#include "snow/array.hpp"
+#include "snow/map.hpp"
 
 #include <memory>
 
@@ -93,10 +97,19 @@ namespace x86_64 {
 		auto ivar_cache = c2.call();
 		movq(ivar_cache, REG_IVAR_CACHE);
 		
+		// Self tail calls jump here after replacing the arguments.
+		body_label = &declare_label("body");
+		label(*body_label);
+		compile_safepoint_poll();
+		
+		compile_parameter_type_checks();
+		
 		AsmValue<VALUE> result(REG_RETURN);
 		clear(result); // always clear return register, so empty functions return nil.
 		return_label = &declare_label("return");
 		
+		if (settings.perform_inlining && parent != nullptr)
+			find_tail_calls(body_seq, true);
 		result = compile_ast_node(body_seq);
 		
 		label(*return_label);
@@ -115,6 +128,8 @@ namespace x86_64 {
 		leave();		
 		ret();
 		
+		compile_self_tail_call_sites();
+		
 		// Fix up stack size
 		size_t temporary_alloc = num_temporaries * sizeof(VALUE);
 		current_stack_frame_size += temporary_alloc;
@@ -197,15 +212,18 @@ namespace x86_64 {
 				return local;
 			}
 			case ASTNodeTypeSelf: {
+				uses_self = true;
 				auto addr = address(get_call_frame(), UNSAFE_OFFSET_OF(CallFrame, self));
 				return AsmValue<VALUE>(addr);
 			}
 			case ASTNodeTypeHere: {
+				uses_frame_arguments = true;
 				auto c_env = call(ccall::call_frame_environment);
 				c_env.set_arg<0>(get_call_frame());
 				return c_env.call();
 			}
 			case ASTNodeTypeIt: {
+				uses_frame_arguments = true;
 				auto c_it = call(ccall::call_frame_get_it);
 				c_it.set_arg<0>(get_call_frame());
 				return c_it.call();
@@ -237,16 +255,17 @@ namespace x86_64 {
 					c_get_property.set_arg<2>(node->method.name);
 					c_get_property.set_arg<3>(method_type);
 					movq(c_get_property.call(), result);
+					compile_unwind_check(); // the getter may be a block that breaks
 					jmp(after);
 				}
 				
 				{
-					// get method proxy wrapper
+					// get bound method wrapper
 					label(get_method);
-					auto c_create_method_proxy = call(ccall::create_method_proxy);
-					c_create_method_proxy.set_arg<0>(self);
-					c_create_method_proxy.set_arg<1>(method);
-					auto r = c_create_method_proxy.call();
+					auto c_create_bound_method = call(ccall::create_bound_method);
+					c_create_bound_method.set_arg<0>(self);
+					c_create_bound_method.set_arg<1>(method);
+					auto r = c_create_bound_method.call();
 					movq(r, result);
 					// jmp(after);
 				}
@@ -294,7 +313,7 @@ namespace x86_64 {
 					movq(result, address(REG_SCRATCH[0], sizeof(VALUE) * i++));
 				}
 				record_source_location(node->association.object);
-				return compile_method_call(self, snow::sym("get"), num_args, args_ptr);
+				return compile_method_call(self, SN_SYM(get), num_args, args_ptr);
 			}
 			case ASTNodeTypeAnd: {
 				Label& left_true = declare_label();
@@ -412,7 +431,9 @@ namespace x86_64 {
 				Label& after = declare_label("loop_after");
 				
 				label(cond);
+				compile_safepoint_poll(); // every iteration, including `continue`
 				AsmValue<VALUE> ret(REG_RETURN);
+				loop_stack.push_back((LoopLabels){ &cond, &after, alloca_total });
 				auto result = compile_ast_node(node->loop.cond);
 				record_source_location(node);
 				movq(result, ret);
@@ -428,16 +449,40 @@ namespace x86_64 {
 				jmp(cond);
 				
 				label(after);
+				loop_stack.pop_back();
 				return ret;
 			}
 			case ASTNodeTypeBreak: {
-				throw_exception_with_description("Codegen: Not implemented: break");
-				return AsmValue<VALUE>();
+				AsmValue<VALUE> ret(REG_RETURN);
+				if (loop_stack.size()) {
+					const LoopLabels& loop = loop_stack.back();
+					clear(ret);
+					if (alloca_total != loop.alloca_total)
+						addq(alloca_total - loop.alloca_total, RSP);
+					jmp(*loop.after);
+				} else if (is_module_method) {
+					// Its definition scope is the module, so it would unwind the whole script.
+					throw_exception_with_description("Codegen: break outside of a loop in '%@', which is defined at module level.", sym_to_cstr(name));
+				} else if (parent != nullptr) {
+					// Non-local exit from a block, see call_frame_begin_unwind.
+					auto c_begin_unwind = call(ccall::call_frame_begin_unwind);
+					c_begin_unwind.set_arg<0>(get_call_frame());
+					c_begin_unwind.call();
+					addq(alloca_total, RSP);
+					jmp(*return_label);
+				} else {
+					throw_exception_with_description("Codegen: break outside of a loop.");
+				}
+				return ret;
 			}
 			case ASTNodeTypeContinue: {
-				// TODO!
-				throw_exception_with_description("Codegen: Not implemented: continue");
-				return AsmValue<VALUE>();
+				if (!loop_stack.size())
+					throw_exception_with_description("Codegen: continue outside of a loop.");
+				const LoopLabels& loop = loop_stack.back();
+				if (alloca_total != loop.alloca_total)
+					addq(alloca_total - loop.alloca_total, RSP);
+				jmp(*loop.cond);
+				return AsmValue<VALUE>(REG_RETURN);
 			}
 			case ASTNodeTypeIfElse: {
 				Label& else_body = declare_label("if_else_body");
@@ -504,6 +549,8 @@ namespace x86_64 {
 				}
 			}
 			SetCurrentAssignmentName assign_name(*this, name);
+			if (parent == nullptr && x->type == ASTNodeTypeClosure)
+				module_methods.insert(x);
 			
 			auto r = compile_ast_node(x);
 			if (r.is_memory()) {
@@ -564,7 +611,7 @@ namespace x86_64 {
 					
 					auto object = compile_ast_node(target->association.object);
 					record_source_location(target);
-					auto r = compile_method_call(object, snow::sym("set"), num_args, args_ptr);
+					auto r = compile_method_call(object, SN_SYM(set), num_args, args_ptr);
 					movq(r, ret);
 					break;
 				}
@@ -593,6 +640,8 @@ namespace x86_64 {
 				}
 				case ASTNodeTypeIdentifier: {
 					record_source_location(target);
+					if (target->identifier.id_type)
+						declare_local_type(target->identifier.name, value_type_from_hint(target->identifier.id_type));
 					compile_set_local(target->identifier.name, values[i], ret);
 					break;
 				}
@@ -607,7 +656,9 @@ namespace x86_64 {
 					else
 						c_object_set.clear_arg<2>();
 					auto r = c_object_set.call();
+					compile_unwind_check(); // the setter may be a block that breaks
 					movq(r, ret);
+					break;
 				}
 				default:
 					throw_exception_with_description("Codegen: Invalid target for assignment. (type: %@)", target->type);
@@ -622,12 +673,14 @@ namespace x86_64 {
 		std::unique_ptr<Codegen::Function> f(new Function(codegen));
 		f->parent = this;
 		f->name = current_assignment_name;
+		f->is_module_method = module_methods.count(function) != 0;
 		if (function->closure.parameters) {
 			f->param_names.reserve(function->closure.parameters->sequence.length);
 			for (const ASTNode* x = function->closure.parameters->sequence.head; x; x = x->next) {
 				ASSERT(x->type == ASTNodeTypeParameter);
 				f->param_names.push_back(x->parameter.name);
 				f->local_names.push_back(x->parameter.name);
+				f->local_types.push_back(value_type_from_hint(x->parameter.id_type));
 			}
 		}
 		f->compile_function_body(function, function->closure.body);
@@ -656,6 +709,95 @@ namespace x86_64 {
 		return out_location.index >= 0;
 	}
 	
+	ValueType Codegen::Function::value_type_from_hint(const ASTNode* id_type) {
+		if (id_type == NULL) return AnyType;
+		ASSERT(id_type->type == ASTNodeTypeIdentifier);
+		const char* name = sym_to_cstr(id_type->identifier.name);
+		if (strcmp(name, "Integer") == 0) return IntegerType;
+		if (strcmp(name, "Float") == 0) return FloatType;
+		if (strcmp(name, "Symbol") == 0) return SymbolType;
+		if (strcmp(name, "Boolean") == 0) return BooleanType;
+		if (strcmp(name, "Nil") == 0) return NilType;
+		return AnyType; // hints naming other classes are accepted, but not checked
+	}
+	
+	ValueType Codegen::Function::get_local_type(const LocalLocation& location) const {
+		if (location.is_global()) return AnyType;
+		const Function* f = this;
+		for (int32_t i = 0; i < location.level; ++i) f = f->parent;
+		return f->local_types[location.index];
+	}
+	
+	void Codegen::Function::declare_local_type(Symbol name, ValueType type) {
+		// A hint is only accepted on the assignment that declares the local, in the function
+		// that owns it. Every other assignment to the local is then compiled after the hint
+		// and checked against it, so the local holds a value of that type or is unassigned.
+		if (parent == nullptr) return; // module globals are untyped
+		LocalLocation location;
+		if (find_local(name, location)) {
+			if (location.level != 0)
+				throw_exception_with_description("Codegen: Type hint for '%@', which belongs to an enclosing scope.", sym_to_cstr(name));
+			throw_exception_with_description("Codegen: Type hint for '%@' must be on its first assignment.", sym_to_cstr(name));
+		}
+		local_names.push_back(name);
+		local_types.push_back(type);
+	}
+	
+	void Codegen::Function::compile_type_test(const AsmValue<VALUE>& value, ValueType type, Label& match) {
+		ASSERT(is_immediate_type(type));
+		movq(value, REG_SCRATCH[0]);
+		if (type == NilType) {
+			// NULL is nil too: unassigned locals and omitted arguments.
+			cmpq(0, REG_SCRATCH[0]);
+			j(CC_EQUAL, match);
+		}
+		// Integers are tagged by the lowest bit alone; other immediates by the full type mask.
+		movq((uint64_t)(type == IntegerType ? 1 : ValueTypeMask), REG_SCRATCH[1]);
+		andq(REG_SCRATCH[1], REG_SCRATCH[0]);
+		cmpq((uint32_t)type, REG_SCRATCH[0]);
+		j(CC_EQUAL, match);
+	}
+	
+	void Codegen::Function::compile_type_check(const AsmValue<VALUE>& value, ValueType type, Symbol name) {
+		if (type == AnyType || type == ObjectType) return;
+		Label& ok = declare_label("type_ok");
+		movq(value, REG_ARGS[0]);
+		compile_type_test(AsmValue<VALUE>(REG_ARGS[0]), type, ok);
+		auto c_mismatch = call(ccall::type_hint_mismatch);
+		c_mismatch.set_arg<1>((int32_t)type);
+		c_mismatch.set_arg<2>(name);
+		c_mismatch.call();
+		label(ok);
+	}
+	
+	void Codegen::Function::compile_parameter_type_checks() {
+		bool any_hints = false;
+		for (size_t i = 0; i < param_names.size(); ++i) {
+			if (local_types[i] != AnyType) any_hints = true;
+		}
+		if (!any_hints) return;
+		
+		auto c_get_locals = call(ccall::call_frame_get_locals);
+		c_get_locals.set_arg<0>(get_call_frame());
+		auto locals = c_get_locals.call();
+		AsmValue<Value*> reg_locals(REG_PRESERVED_SCRATCH[0]);
+		movq(locals, reg_locals);
+		for (size_t i = 0; i < param_names.size(); ++i) {
+			compile_type_check(AsmValue<VALUE>(address(reg_locals, i * sizeof(VALUE))), local_types[i], param_names[i]);
+		}
+	}
+	
+	void Codegen::Function::compile_safepoint_poll() {
+		// Compiled code belongs to a single isolate, so the address of its flag is a constant.
+		Label& resume = declare_label("safepoint_resume");
+		movq((uintptr_t)safepoint_flag(), REG_SCRATCH[0]);
+		cmpb((uint8_t)0, address(REG_SCRATCH[0]));
+		j(CC_EQUAL, resume);
+		auto c_park = call(snow::safepoint_park);
+		c_park.call();
+		label(resume);
+	}
+	
 	AsmValue<VALUE> Codegen::Function::compile_get_local(Symbol name, Register result_hint) {
 		LocalLocation location;
 		if (find_local(name, location)) {
@@ -698,9 +840,12 @@ namespace x86_64 {
 				location.level = 0;
 				location.index = local_names.size();
 				local_names.push_back(name);
+				local_types.push_back(AnyType);
 			}
 		}
 		
+		compile_type_check(value, get_local_type(location), name);
+		
 		AsmValue<VALUE> result(result_hint);
 		if (location.is_global()) {
 			auto c_set_global = call(ccall::set_global);
@@ -789,20 +934,29 @@ namespace x86_64 {
 			movq(REG_SCRATCH[0], address(REG_ARGS[2], sizeof(Symbol) * i));
 		}
 		
+		const bool is_tail_call = tail_calls.count(node) != 0;
 		if (node->call.object->type == ASTNodeTypeMethod) {
-			auto object = compile_ast_node(node->call.object->method.object);
+			const ASTNode* object_node = node->call.object->method.object;
+			ValueType object_type = AnyType;
+			LocalLocation location;
+			if (object_node->type == ASTNodeTypeIdentifier && find_local(object_node->identifier.name, location))
+				object_type = get_local_type(location);
+			auto object = compile_ast_node(object_node);
 			record_source_location(node->call.object);
-			return compile_method_call(object, node->call.object->method.name, args.size(), args_ptr, names.size(), names_ptr);
+			compiling_tail_call = is_tail_call;
+			return compile_method_call(object, node->call.object->method.name, args.size(), args_ptr, names.size(), names_ptr, object_type);
 		} else {
 			auto functor = compile_ast_node(node->call.object);
 			AsmValue<VALUE> self(REG_ARGS[1]);
 			clear(self); // self = NULL
+			compiling_tail_call = is_tail_call;
 			return compile_call(functor, self, args.size(), args_ptr, names.size(), names_ptr);
 		}
 	}
 	
 	AsmValue<VALUE> Codegen::Function::compile_call(const AsmValue<VALUE>& functor, const AsmValue<VALUE>& self, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names, const AsmValue<Symbol*>& names_ptr) {
 		if (num_names) {
+			compiling_tail_call = false;
 			ASSERT(num_args >= num_names);
 			auto c_call = call(ccall::call_with_named_arguments);
 			c_call.set_arg<0>(functor);
@@ -811,8 +965,14 @@ namespace x86_64 {
 			c_call.set_arg<3>(names_ptr);
 			c_call.set_arg<4>(num_args);
 			c_call.set_arg<5>(args_ptr);
-			return c_call.call();
+			auto result = c_call.call();
+			compile_unwind_check();
+			return result;
 		} else {
+			if (compiling_tail_call) {
+				compiling_tail_call = false;
+				compile_self_tail_call_check(functor, NULL, NULL, num_args, args_ptr);
+			}
 			auto c_call = call(ccall::call);
 			c_call.set_arg<0>(functor);
 			c_call.set_arg<1>(self);
@@ -821,19 +981,131 @@ namespace x86_64 {
 			else
 				c_call.clear_arg<2>();
 			c_call.set_arg<3>(args_ptr);
-			return c_call.call();
+			auto result = c_call.call();
+			compile_unwind_check();
+			return result;
+		}
+	}
+	
+	void Codegen::Function::find_tail_calls(const ASTNode* node, bool is_tail) {
+		if (node == NULL) return;
+		switch (node->type) {
+			case ASTNodeTypeSequence:
+				for (const ASTNode* x = node->sequence.head; x; x = x->next)
+					find_tail_calls(x, is_tail && x->next == NULL);
+				break;
+			case ASTNodeTypeIfElse:
+				find_tail_calls(node->if_else.body, is_tail);
+				find_tail_calls(node->if_else.else_body, is_tail);
+				break;
+			case ASTNodeTypeLoop:
+				find_tail_calls(node->loop.body, false); // for returns in the loop body
+				break;
+			case ASTNodeTypeReturn:
+				find_tail_calls(node->return_expr.value, true);
+				break;
+			case ASTNodeTypeCall:
+				if (is_tail) tail_calls.insert(node);
+				break;
+			default:
+				break;
 		}
 	}
 	
-	AsmValue<VALUE> Codegen::Function::compile_method_call(const AsmValue<VALUE>& in_self, Symbol method_name, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names, const AsmValue<Symbol*>& names_ptr) {
+	void Codegen::Function::compile_self_tail_call_check(const AsmValue<VALUE>& callee, const AsmValue<VALUE>* self, const AsmValue<MethodType>* type, size_t num_args, const AsmValue<VALUE*>& args_ptr) {
+		// A call in tail position to the function itself, with the same self and no captured
+		// environment, reuses the current frame: see compile_self_tail_call_sites.
+		if (num_args > param_names.size()) return;
+		Label& jump = declare_label("tail_call");
+		Label& normal_call = declare_label("tail_call_normal");
+		auto scratch = REG_SCRATCH[7];
+		if (type) {
+			cmpl((uint32_t)MethodTypeFunction, *type);
+			j(CC_NOT_EQUAL, normal_call);
+		}
+		movq(address(get_call_frame(), UNSAFE_OFFSET_OF(CallFrame, function)), scratch);
+		cmpq(callee, scratch);
+		j(CC_NOT_EQUAL, normal_call);
+		if (self) {
+			movq(address(get_call_frame(), UNSAFE_OFFSET_OF(CallFrame, self)), scratch);
+			cmpq(*self, scratch);
+			j(CC_NOT_EQUAL, normal_call);
+		}
+		cmpq(0, address(get_call_frame(), UNSAFE_OFFSET_OF(CallFrame, environment)));
+		j(CC_NOT_EQUAL, normal_call);
+		jmp(jump);
+		label(normal_call);
+		tail_call_sites.push_back((TailCallSite){ &jump, &normal_call, args_ptr.op, num_args, alloca_total, self != NULL });
+	}
+	
+	void Codegen::Function::compile_self_tail_call_sites() {
+		// Emitted after the function body, when it is known whether the function reads
+		// its original arguments through `it` or `here`; CallFrame::args is owned by the
+		// caller and cannot be replaced, so such functions always make a regular call.
+		// Likewise, a call without a receiver binds self from the definition scope, which
+		// may differ from the current self.
+		auto locals = REG_SCRATCH[0];
+		auto args = REG_SCRATCH[1];
+		auto scratch = REG_SCRATCH[2];
+		for (auto it = tail_call_sites.begin(); it != tail_call_sites.end(); ++it) {
+			label(*it->jump);
+			if (uses_frame_arguments || (uses_self && !it->same_self)) {
+				jmp(*it->call);
+				continue;
+			}
+			movq(address(get_call_frame(), UNSAFE_OFFSET_OF(CallFrame, locals)), locals);
+			movq(it->args_ptr, args);
+			for (size_t i = 0; i < it->num_args; ++i) {
+				movq(address(args, i * sizeof(VALUE)), scratch);
+				movq(scratch, address(locals, i * sizeof(VALUE)));
+			}
+			for (size_t i = it->num_args; i < local_names.size(); ++i) {
+				movq((uint32_t)0, address(locals, i * sizeof(VALUE)));
+			}
+			if (it->alloca_total)
+				addq(it->alloca_total, RSP);
+			jmp(*body_label);
+		}
+	}
+	
+	void Codegen::Function::compile_unwind_check() {
+		// A call that returns SN_UNWINDING is being unwound by a non-local block exit.
+		// Stop here if this frame defined the block, otherwise keep unwinding.
+		Label& done = declare_label("unwind_check_done");
+		cmpq((uint32_t)(uintptr_t)SN_UNWINDING, REG_RETURN);
+		j(CC_NOT_EQUAL, done);
+		auto c_finish_unwind = call(ccall::call_frame_finish_unwind);
+		c_finish_unwind.set_arg<0>(get_call_frame());
+		c_finish_unwind.call();
+		cmpq((uint32_t)(uintptr_t)SN_UNWINDING, REG_RETURN);
+		j(CC_NOT_EQUAL, done);
+		addq(alloca_total, RSP);
+		jmp(*return_label);
+		label(done);
+	}
+	
+	AsmValue<VALUE> Codegen::Function::compile_method_call(const AsmValue<VALUE>& in_self, Symbol method_name, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names, const AsmValue<Symbol*>& names_ptr, ValueType self_type) {
 		ASSERT(args_ptr.op.is_memory());
 		if (num_names) ASSERT(names_ptr.op.is_memory());
+		const bool is_tail_call = compiling_tail_call && num_names == 0;
+		compiling_tail_call = false;
 		AsmValue<VALUE> self(REG_PRESERVED_SCRATCH[1]);
 		movq(in_self, self);
 		
+		Label* inlined_done = NULL;
+		if (num_names == 0 && settings.perform_inlining) {
+			if (num_args == 1)
+				inlined_done = compile_inlined_integer_operator(self, method_name, args_ptr);
+			if (!inlined_done)
+				inlined_done = compile_inlined_collection_access(self, method_name, num_args, args_ptr);
+		}
+		
 		AsmValue<VALUE> method(REG_ARGS[0]);
 		AsmValue<MethodType> type(REG_ARGS[4]);
-		compile_get_method_inline_cache(self, method_name, type, method);
+		if (!compile_get_method_prebound(self, self_type, method_name, type, method))
+			compile_get_method_inline_cache(self, method_name, type, method);
+		if (is_tail_call)
+			compile_self_tail_call_check(method, &self, &type, num_args, args_ptr);
 		auto c_call = call(ccall::call_method);
 		c_call.set_arg<0>(method);
 		c_call.set_arg<1>(self);
@@ -841,7 +1113,213 @@ namespace x86_64 {
 		c_call.set_arg<3>(args_ptr);
 		c_call.set_arg<4>(type);
 		c_call.set_arg<5>(method_name);
-		return c_call.call();
+		auto result = c_call.call();
+		compile_unwind_check();
+		if (inlined_done) label(*inlined_done);
+		return result;
+	}
+	
+	Label* Codegen::Function::compile_inlined_collection_access(const AsmValue<VALUE>& self, Symbol name, size_t num_args, const AsmValue<VALUE*>& args_ptr) {
+		bool is_set;
+		if (name == SN_SYM(get) && num_args == 1) is_set = false;
+		else if (name == SN_SYM(set) && num_args == 2) is_set = true;
+		else return NULL;
+		
+		int32_t begin_offset, end_offset;
+		const bool inline_array = array_get_storage_layout(&begin_offset, &end_offset);
+		
+		Label& done = declare_label("inlined_collection_access_done");
+		Label& not_array = declare_label("inlined_collection_access_not_array");
+		Label& slow = declare_label("inlined_collection_access_slow");
+		
+		auto object = REG_SCRATCH[0];
+		auto key = REG_SCRATCH[1];
+		auto scratch = REG_SCRATCH[2];
+		auto scratch2 = REG_SCRATCH[3];
+		auto args = REG_SCRATCH[4];
+		auto val = REG_SCRATCH[5];
+		AsmValue<VALUE> result(REG_RETURN);
+		
+		// The receiver must be a non-null object whose class is exactly Array or Map.
+		// Both define get/set themselves, and methods cannot be redefined, so no
+		// method table guard is needed.
+		movq(self, object);
+		cmpq(0, object);
+		j(CC_EQUAL, slow);
+		movq((uint64_t)ValueTypeMask, scratch);
+		andq(object, scratch);
+		j(CC_NOT_ZERO, slow);
+		movq(args_ptr, args);
+		movq(address(args), key);
+		if (is_set) movq(address(args, sizeof(VALUE)), val);
+		movq(address(object, offsetof(Object, cls)), scratch);
+		
+		if (inline_array) {
+			movq((uint64_t)get_array_class().value(), scratch2);
+			cmpq(scratch2, scratch);
+			j(CC_NOT_EQUAL, not_array);
+			// Only non-negative integer indices within bounds are handled inline; negative
+			// indices and growing the array are left to the native implementation.
+			movq(key, scratch2);
+			movq((uint64_t)1, scratch);
+			andq(scratch, scratch2);
+			j(CC_ZERO, slow);
+			cmpq(0, key);
+			j(CC_LESS, slow);
+			movq(address(object, begin_offset), scratch);
+			leaq(sib(SibScale_4, key, scratch, -4), scratch); // tagged index (i << 1 | 1) * 4 - 4 == i * sizeof(VALUE)
+			movq(address(object, end_offset), scratch2);
+			cmpq(scratch2, scratch);
+			j(CC_NOT_BELOW, slow);
+			if (is_set) {
+				movq(val, address(scratch));
+				movq(val, result);
+			} else {
+				movq(address(scratch), result);
+			}
+			jmp(done);
+			label(not_array);
+			movq(address(object, offsetof(Object, cls)), scratch);
+		} else {
+			label(not_array);
+		}
+		
+		// Map#get and Map#set are native wrappers around map_get and map_set, so call those
+		// directly. They return a stored value, never SN_UNWINDING, so no unwind check is
+		// needed. Only immediate keys take this path; other keys may call hash, <=> or = on
+		// the key and are left to the full method call.
+		movq((uint64_t)get_map_class().value(), scratch2);
+		cmpq(scratch2, scratch);
+		j(CC_NOT_EQUAL, slow);
+		movq((uint64_t)ValueTypeMask, scratch);
+		andq(key, scratch);
+		j(CC_ZERO, slow);
+		if (is_set) {
+			auto c_map_set = call(ccall::map_set);
+			c_map_set.set_arg<0>(AsmValue<VALUE>(object));
+			c_map_set.set_arg<1>(AsmValue<VALUE>(key));
+			c_map_set.set_arg<2>(AsmValue<VALUE>(val));
+			c_map_set.call();
+		} else {
+			auto c_map_get = call(ccall::map_get);
+			c_map_get.set_arg<0>(AsmValue<VALUE>(object));
+			c_map_get.set_arg<1>(AsmValue<VALUE>(key));
+			c_map_get.call();
+		}
+		jmp(done);
+		
+		label(slow);
+		return &done;
+	}
+	
+	ClassConstPtr Codegen::Function::compile_method_owner_guard(ClassConstPtr cls, Symbol name, Label& fail) {
+		// Methods cannot be redefined, only shadowed, so binding at compile time is safe as long as
+		// no method has been added to the classes searched before the owner.
+		ClassConstPtr owner = class_get_method_owner(cls, name);
+		if (owner == NULL) return NULL;
+		for (ClassConstPtr c = cls; c != owner; c = class_get_super(c)) {
+			const uint32_t* version = class_get_methods_version(c);
+			movq((uint64_t)version, REG_SCRATCH[0]);
+			cmpl(*version, address(REG_SCRATCH[0]));
+			j(CC_NOT_EQUAL, fail);
+		}
+		return owner;
+	}
+	
+	Label* Codegen::Function::compile_inlined_integer_operator(const AsmValue<VALUE>& self, Symbol name, const AsmValue<VALUE*>& args_ptr) {
+		enum { OpAdd, OpSubtract, OpCompare } op;
+		Condition cc = CC_EQUAL;
+		switch (name) {
+			case SN_SYM(add):           op = OpAdd; break;
+			case SN_SYM(subtract):      op = OpSubtract; break;
+			case SN_SYM(less):          op = OpCompare; cc = CC_LESS; break;
+			case SN_SYM(less_equal):    op = OpCompare; cc = CC_LESS_EQUAL; break;
+			case SN_SYM(greater):       op = OpCompare; cc = CC_GREATER; break;
+			case SN_SYM(greater_equal): op = OpCompare; cc = CC_GREATER_EQUAL; break;
+			default: return NULL;
+		}
+		
+		// Only the native Numeric operators are inlined.
+		if (class_get_method_owner(get_integer_class(), name) != get_numeric_class())
+			return NULL;
+		
+		Label& done = declare_label("inlined_integer_operator_done");
+		Label& slow = declare_label("inlined_integer_operator_slow");
+		compile_method_owner_guard(get_integer_class(), name, slow);
+		
+		auto arg = REG_SCRATCH[0];
+		auto left = REG_SCRATCH[1];
+		auto scratch = REG_SCRATCH[2];
+		auto scratch2 = REG_SCRATCH[3];
+		AsmValue<VALUE> result(REG_RETURN);
+		
+		// Class guard: both operands must be integers (tag bit set).
+		movq(args_ptr, arg);
+		movq(address(arg), arg);
+		movq(self, left);
+		movq(left, scratch);
+		andq(arg, scratch);
+		movq((uint64_t)1, scratch2);
+		andq(scratch2, scratch);
+		j(CC_ZERO, slow);
+		
+		if (op == OpCompare) {
+			// Tagged integers compare like the integers they represent.
+			movq((uint64_t)SN_FALSE, result);
+			cmpq(arg, left);
+			j((Condition)(cc ^ 1), done); // x86 condition codes come in pairs; the low bit negates
+			movq((uint64_t)SN_TRUE, result);
+			jmp(done);
+		} else {
+			// (a << 1 | 1) + (b << 1 | 1) - 1 == (a + b) << 1 | 1, likewise for subtraction.
+			movq(left, result);
+			if (op == OpAdd) {
+				subq(1, result);
+				addq(arg, result);
+			} else {
+				subq(arg, result);
+				addq(1, result);
+			}
+			// Leave results that overflow 32 bits to the native implementation.
+			movq((uint64_t)(VALUE)integer_to_value(INT32_MAX), scratch);
+			cmpq(scratch, result);
+			j(CC_GREATER, slow);
+			movq((uint64_t)(VALUE)integer_to_value(INT32_MIN), scratch);
+			cmpq(scratch, result);
+			j(CC_LESS, slow);
+			jmp(done);
+		}
+		
+		label(slow);
+		return &done;
+	}
+	
+	bool Codegen::Function::compile_get_method_prebound(const AsmValue<VALUE>& object, ValueType self_type, Symbol name, const AsmValue<MethodType>& out_type, const AsmValue<VALUE>& out_method) {
+		// When the receiver is hinted as an immediate type, its class is known at compile time,
+		// so regular functions can be bound directly without going through the inline cache.
+		// Hinted locals may still be unassigned (the declaring assignment need not have run),
+		// so the receiver's tag is tested before the bound method is used.
+		if (self_type == AnyType || self_type == ObjectType)
+			return false;
+		ClassConstPtr cls = get_immediate_class(self_type);
+		MethodQueryResult method;
+		class_lookup_method(cls, name, &method);
+		if (method.type != MethodTypeFunction)
+			return false;
+		Label& lookup = declare_label("prebound_method_lookup");
+		Label& bound = declare_label("prebound_method");
+		Label& receiver_ok = declare_label("prebound_receiver_ok");
+		compile_type_test(object, self_type, receiver_ok);
+		jmp(lookup);
+		label(receiver_ok);
+		compile_method_owner_guard(cls, name, lookup);
+		movq((uint64_t)method.result, out_method);
+		movl((uint32_t)MethodTypeFunction, out_type);
+		jmp(bound);
+		label(lookup);
+		compile_get_method_inline_cache(object, name, out_type, out_method);
+		label(bound);
+		return true;
 	}
 	
 	void Codegen::Function::compile_get_method_inline_cache(const AsmValue<VALUE>& object, Symbol name, const AsmValue<MethodType>& out_type, const AsmValue<VALUE>& out_method_getter) {
@@ -1000,8 +1478,8 @@ namespace x86_64 {
 		}
 		
 		fixup_param_types_ptr.value = get_current_offset();
-		for (auto it = param_names.begin(); it != param_names.end(); ++it) {
-			emit_u32(AnyType);
+		for (size_t i = 0; i < param_names.size(); ++i) {
+			emit_u32(local_types[i]);
 		}
 		
 		align_to(sizeof(void*));
@@ -13,6 +13,7 @@
 
 #include <tuple>
 #include <map>
+#include <set>
 
 namespace snow {
 namespace x86_64 {
@@ -134,7 +135,11 @@ namespace x86_64 {
 		Function(Codegen& codegen) :
 			codegen(codegen),
 			settings(codegen._settings),
-			needs_environment(true)
+			needs_environment(true),
+			is_module_method(false),
+			compiling_tail_call(false),
+			uses_frame_arguments(false),
+			uses_self(false)
 		{}
 
 		// Settings
@@ -173,6 +178,7 @@ namespace x86_64 {
 		ReadOnly<Function, Symbol>    name;
 		Names                         local_names;
 		Names                         param_names; 
+		std::vector<ValueType>        local_types; // type hints, parallel to local_names
 		ReadOnly<Function, bool>      needs_environment;
 		// Inline cache information
 		ReadOnly<Function, size_t>    num_method_calls;
@@ -184,6 +190,23 @@ namespace x86_64 {
 		
 		// Internal consistency
 		Label* return_label;
+		struct LoopLabels { Label* cond; Label* after; size_t alloca_total; };
+		std::vector<LoopLabels> loop_stack;
+		void compile_unwind_check();
+		bool is_module_method; // assigned to a name in the module body, so `break` has no block to end
+		std::set<const ASTNode*> module_methods; // in the module body: closures assigned to a name
+		
+		// Tail calls
+		Label* body_label;
+		std::set<const ASTNode*> tail_calls;
+		bool compiling_tail_call; // set while emitting the call for a node in tail_calls
+		bool uses_frame_arguments; // `it` or `here` need the original CallFrame::args
+		bool uses_self;
+		struct TailCallSite { Label* jump; Label* call; Operand args_ptr; size_t num_args; size_t alloca_total; bool same_self; };
+		std::vector<TailCallSite> tail_call_sites;
+		void find_tail_calls(const ASTNode* node, bool is_tail);
+		void compile_self_tail_call_check(const AsmValue<VALUE>& callee, const AsmValue<VALUE>* self, const AsmValue<MethodType>* type, size_t num_args, const AsmValue<VALUE*>& args_ptr);
+		void compile_self_tail_call_sites();
 		struct FunctionDescriptorReference { CodeBuffer::Fixup& fixup; Function* function; FunctionDescriptorReference(CodeBuffer::Fixup& fixup, Function* function) : fixup(fixup), function(function) {} };
 		std::list<FunctionDescriptorReference> function_descriptor_references;
 
@@ -207,9 +230,14 @@ namespace x86_64 {
 		AsmValue<VALUE> compile_assignment(const ASTNode* assign);
 		AsmValue<VALUE> compile_call(const ASTNode* call);
 		AsmValue<VALUE> compile_call(const AsmValue<VALUE>& functor, const AsmValue<VALUE>& self, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names = 0, const AsmValue<Symbol*>& names_ptr = AsmValue<Symbol*>());
-		AsmValue<VALUE> compile_method_call(const AsmValue<VALUE>& self, Symbol method_name, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names = 0, const AsmValue<Symbol*>& names_ptr = AsmValue<Symbol*>());
+		AsmValue<VALUE> compile_method_call(const AsmValue<VALUE>& self, Symbol method_name, size_t num_args, const AsmValue<VALUE*>& args_ptr, size_t num_names = 0, const AsmValue<Symbol*>& names_ptr = AsmValue<Symbol*>(), ValueType self_type = AnyType);
 		void compile_get_method_inline_cache(const AsmValue<VALUE>& self, Symbol name, const AsmValue<MethodType>& out_type, const AsmValue<VALUE>& out_method);
+		bool compile_get_method_prebound(const AsmValue<VALUE>& self, ValueType self_type, Symbol name, const AsmValue<MethodType>& out_type, const AsmValue<VALUE>& out_method);
+		ClassConstPtr compile_method_owner_guard(ClassConstPtr cls, Symbol name, Label& fail);
+		Label* compile_inlined_collection_access(const AsmValue<VALUE>& self, Symbol name, size_t num_args, const AsmValue<VALUE*>& args_ptr);
+		Label* compile_inlined_integer_operator(const AsmValue<VALUE>& self, Symbol name, const AsmValue<VALUE*>& args_ptr);
 		void compile_get_index_of_field_inline_cache(const AsmValue<VALUE>& self, Symbol name, const AsmValue<int32_t>& target, bool can_define = false);
+		void compile_safepoint_poll();
 		
 		// Local variable handling
 		struct LocalLocation {
@@ -221,6 +249,14 @@ namespace x86_64 {
 		bool find_local(Symbol name, LocalLocation& location) const;
 		AsmValue<VALUE> compile_get_local(Symbol name, Register result_hint = REG_RETURN);
 		AsmValue<VALUE> compile_set_local(Symbol name, AsmValue<VALUE> value, Register result_hint = REG_RETURN);
+		
+		// Type hints
+		static ValueType value_type_from_hint(const ASTNode* id_type);
+		ValueType get_local_type(const LocalLocation& location) const;
+		void declare_local_type(Symbol name, ValueType type);
+		void compile_type_test(const AsmValue<VALUE>& value, ValueType type, Label& match);
+		void compile_type_check(const AsmValue<VALUE>& value, ValueType type, Symbol name);
+		void compile_parameter_type_checks();
 		ReadOnly<Function, Symbol> current_assignment_name; // Used to determine the name of functions.
 		struct SetCurrentAssignmentName {
 			SetCurrentAssignmentName(Function& f, Symbol name) : f(f) {
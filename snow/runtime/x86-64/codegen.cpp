@@ -57,6 +57,12 @@ namespace x86_64 {
 		// Transform and save debug information
 		offset = 0;
 		for (const Function* function: _functions) {
+			CodeFunction range;
+			range.code_offset = offset + function->materialized_code_offset;
+			range.code_length = function->materialized_code_length;
+			range.name = function->name;
+			module.functions.push_back(range);
+			
 			for (const SourceLocation& local: function->source_locations) {
 				SourceLocation location;
 				location.code_offset = offset + local.code_offset;
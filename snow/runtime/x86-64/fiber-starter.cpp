@@ -1,44 +1,85 @@
 #include "snow/fiber.hpp"
 #include "../fiber-internal.hpp"
 
-#include <assert.h>
-
-static void _fiber_trampoline() {
-	__asm__ __volatile__(
-		"movq 0x10(%%rsp), %%rdi\n"
-		"movq %%rax, %%rsi\n"     // value returned from the 
-		"movq 0x8(%%rsp), %%r8\n" // return callback
-		"jmp *%%r8\n"
-	: : : "%rdi", "%rsi", "%r8"
-	);
-}
+/*
+	Fiber context switching for x86-64 (System V ABI).
+
+	A suspended fiber is represented by its saved stack pointer alone. Switching
+	pushes the callee-saved registers and the FPU/SSE control words onto the
+	current stack, stores the stack pointer, loads the other fiber's stack pointer
+	and pops the same set in reverse. Caller-saved registers are already dead at
+	the call site, so nothing else needs saving.
+
+	Saved context layout, from the saved stack pointer upwards:
+
+		mxcsr (4 bytes), x87 control word (2 bytes), padding (2 bytes)
+		r15
+		r14
+		r13
+		r12
+		rbx
+		rbp
+		return address
+*/
 
 namespace snow {
+	namespace {
+		/*
+			First code to run on a new fiber. fiber_prepare_context puts the entry
+			function in r12 and its argument in rbx. The stack pointer is 16-byte
+			aligned here, so the call leaves the entry function with a correctly
+			aligned frame. Entry functions never return.
+		*/
+		__attribute__((naked, noinline, used))
+		void fiber_trampoline() {
+			__asm__ __volatile__(
+				"movq %rbx, %rdi\n"
+				"xorq %rbp, %rbp\n"   // terminate frame pointer chains
+				"callq *%r12\n"
+				"ud2\n"
+			);
+		}
+	}
 
-void __attribute__((noreturn))
-start_fiber(FiberPtr fiber, byte* stack, FiberPtr caller, VALUE data, FiberStartFunc start_func, FiberReturnFunc return_callback)
-{
-	void** stack_top = (void**)(stack + SN_FIBER_STACK_SIZE);
-	
-	*(stack_top-1) = fiber.value();
-	*(stack_top-2) = (void*)return_callback; 
-	*(stack_top-3) = (void*)_fiber_trampoline; // "saved" rip
-	
-	__asm__ __volatile__(
-		"movq %0, %%rdi\n"
-		"movq %1, %%rsi\n"
-		"movq %2, %%rdx\n"
-		"movq %3, %%r8\n"
-		"movq %4, %%rsp\n"
-		"movq %%rsp, %%rbp\n"
-		"subq $0x10, %%rbp\n" // rbp for trampoline
-		"jmpq *%%r8\n"
-		:
-		: "r"(fiber.value()), "r"(caller.value()), "r"(data), "r"(start_func), "r"(stack_top-3)
-		: "%rdi", "%rsi", "%rdx", "%r8", "%rsp"
-	);
-	
-	assert(false);
-}
+	void* fiber_prepare_context(byte* stack_top, FiberEntryFunc entry, void* data) {
+		void** sp = (void**)((uintptr_t)stack_top & ~(uintptr_t)0xf);
+		*--sp = (void*)fiber_trampoline; // return address
+		*--sp = NULL;                    // rbp
+		*--sp = data;                    // rbx
+		*--sp = (void*)entry;            // r12
+		*--sp = NULL;                    // r13
+		*--sp = NULL;                    // r14
+		*--sp = NULL;                    // r15
+		*--sp = (void*)(0x037fULL << 32 | 0x1f80ULL); // default x87 control word and mxcsr
+		return sp;
+	}
+
+	__attribute__((naked, noinline))
+	void fiber_switch_context(void** save_sp, void* restore_sp) {
+		__asm__ __volatile__(
+			"pushq %rbp\n"
+			"pushq %rbx\n"
+			"pushq %r12\n"
+			"pushq %r13\n"
+			"pushq %r14\n"
+			"pushq %r15\n"
+			"subq $8, %rsp\n"
+			"stmxcsr (%rsp)\n"
+			"fnstcw 4(%rsp)\n"
 
-}
\ No newline at end of file
+			"movq %rsp, (%rdi)\n"
+			"movq %rsi, %rsp\n"
+
+			"ldmxcsr (%rsp)\n"
+			"fldcw 4(%rsp)\n"
+			"addq $8, %rsp\n"
+			"popq %r15\n"
+			"popq %r14\n"
+			"popq %r13\n"
+			"popq %r12\n"
+			"popq %rbx\n"
+			"popq %rbp\n"
+			"retq\n"
+		);
+	}
+}
@@ -0,0 +1,188 @@
+#include "test.hpp"
+#include "snow/array.hpp"
+#include "snow/channel.hpp"
+#include "snow/exception.hpp"
+#include "snow/fiber.hpp"
+#include "snow/function.hpp"
+#include "snow/numeric.hpp"
+#include <string>
+
+static std::string channel_log;
+
+static void spawn_with(Value self, FunctionPtr function, const char* name) {
+	fiber_spawn(create_bound_method(self, create_function(function, snow::sym(name))));
+}
+
+static void log_value(Value value) {
+	channel_log += (char)('0' + value_to_integer(value));
+}
+
+static VALUE send_two_function(const CallFrame* here, VALUE self, VALUE it) {
+	channel_send(self, integer_to_value(1));
+	channel_log += 's';
+	channel_send(self, integer_to_value(2));
+	channel_log += 's';
+	return SN_NIL;
+}
+
+static VALUE send_seven_function(const CallFrame* here, VALUE self, VALUE it) {
+	channel_send(self, integer_to_value(7));
+	channel_log += 's';
+	return SN_NIL;
+}
+
+static VALUE receive_function(const CallFrame* here, VALUE self, VALUE it) {
+	bool closed;
+	Value value = channel_receive(self, &closed);
+	if (closed)
+		channel_log += 'c';
+	else
+		log_value(value);
+	return SN_NIL;
+}
+
+static VALUE receive_two_function(const CallFrame* here, VALUE self, VALUE it) {
+	log_value(channel_receive(self));
+	log_value(channel_receive(self));
+	return SN_NIL;
+}
+
+static VALUE send_until_closed_function(const CallFrame* here, VALUE self, VALUE it) {
+	try {
+		channel_send(self, integer_to_value(1));
+		channel_log += 's';
+	}
+	catch (ExceptionPtr ex) {
+		channel_log += 'x';
+	}
+	return SN_NIL;
+}
+
+static VALUE close_function(const CallFrame* here, VALUE self, VALUE it) {
+	ObjectPtr<Array> channels = self;
+	for (size_t i = 0; i < array_size(channels); ++i) {
+		channel_close(array_get(channels, i));
+	}
+	return SN_NIL;
+}
+
+static VALUE select_function(const CallFrame* here, VALUE self, VALUE it) {
+	ObjectPtr<Array> channels = self;
+	ChannelPtr list[2];
+	list[0] = array_get(channels, 0);
+	list[1] = array_get(channels, 1);
+	Value value;
+	bool closed;
+	size_t index = channel_select(list, 2, &value, &closed);
+	channel_log += (char)('a' + index);
+	if (closed)
+		channel_log += 'c';
+	else
+		log_value(value);
+	return SN_NIL;
+}
+
+static ObjectPtr<Array> pair(Value a, Value b) {
+	Value values[] = { a, b };
+	return create_array_from_range(values, values + 2);
+}
+
+BEGIN_TESTS()
+BEGIN_GROUP("Buffering")
+
+STORY("an unbounded channel takes every send and hands values out in order", {
+	ObjectPtr<Channel> channel = create_channel();
+	for (int i = 1; i <= 20; ++i) {
+		channel_send(channel, integer_to_value(i)); // never blocks, so fine outside the scheduler
+	}
+	TEST_EQ(channel_size(channel), 20);
+	for (int i = 1; i <= 20; ++i) {
+		TEST_EQ(value_to_integer(channel_receive(channel)), i);
+	}
+	TEST_EQ(channel_size(channel), 0);
+});
+
+STORY("a bounded channel makes the sender wait while it is full", {
+	channel_log.clear();
+	ObjectPtr<Channel> channel = create_channel(1);
+	spawn_with(channel, send_two_function, "send_two");
+	spawn_with(channel, receive_two_function, "receive_two");
+	fiber_run_scheduler();
+	TEST_EQ(channel_log, "s12s");
+});
+
+STORY("an unbuffered channel hands the value directly to a receiver", {
+	channel_log.clear();
+	ObjectPtr<Channel> channel = create_channel(0);
+	spawn_with(channel, send_seven_function, "send_seven");
+	spawn_with(channel, receive_function, "receive");
+	fiber_run_scheduler();
+	TEST_EQ(channel_log, "7s"); // the sender waited for the receiver
+	TEST_EQ(channel_size(channel), 0);
+});
+
+END_GROUP()
+BEGIN_GROUP("Closing")
+
+STORY("closing a channel wakes its waiting receivers and senders", {
+	channel_log.clear();
+	ObjectPtr<Channel> empty = create_channel();
+	ObjectPtr<Channel> unbuffered = create_channel(0);
+	spawn_with(empty, receive_function, "receive");
+	spawn_with(unbuffered, send_until_closed_function, "send_until_closed");
+	spawn_with(pair(empty, unbuffered), close_function, "close");
+	fiber_run_scheduler();
+	TEST_EQ(channel_log, "cx");
+});
+
+STORY("receiving from a closed channel drains it first, then reports closed", {
+	ObjectPtr<Channel> channel = create_channel();
+	channel_send(channel, integer_to_value(1));
+	channel_close(channel);
+	bool closed;
+	TEST_EQ(value_to_integer(channel_receive(channel, &closed)), 1);
+	TEST_EQ(closed, false);
+	TEST_EQ(channel_receive(channel, &closed), SN_NIL);
+	TEST_EQ(closed, true);
+});
+
+END_GROUP()
+BEGIN_GROUP("Select")
+
+STORY("select receives from whichever channel gets a value", {
+	channel_log.clear();
+	ObjectPtr<Channel> a = create_channel(0);
+	ObjectPtr<Channel> b = create_channel(0);
+	spawn_with(pair(a, b), select_function, "select");
+	spawn_with(b, send_seven_function, "send_seven");
+	fiber_run_scheduler();
+	TEST_EQ(channel_log, "sb7"); // handing over does not wait for the selecting fiber to run
+});
+
+STORY("select reports a channel closed while it waits", {
+	channel_log.clear();
+	ObjectPtr<Channel> a = create_channel();
+	ObjectPtr<Channel> b = create_channel();
+	spawn_with(pair(a, b), select_function, "select");
+	spawn_with(pair(b, b), close_function, "close");
+	fiber_run_scheduler();
+	TEST_EQ(channel_log, "bc");
+});
+
+STORY("select prefers a buffered value to a closed channel", {
+	ObjectPtr<Channel> channels[2];
+	channels[0] = create_channel();
+	channels[1] = create_channel();
+	channel_close(channels[0]);
+	channel_send(channels[1], integer_to_value(3));
+	Value value;
+	bool closed;
+	TEST_EQ(channel_select(channels, 2, &value, &closed), 1);
+	TEST_EQ(value_to_integer(value), 3);
+	TEST_EQ(closed, false);
+	TEST_EQ(channel_select(channels, 2, &value, &closed), 0);
+	TEST_EQ(closed, true);
+});
+
+END_GROUP()
+END_TESTS()
@@ -1,7 +1,10 @@
 #include "test.hpp"
+#include "snow/channel.hpp"
+#include "snow/exception.hpp"
 #include "snow/fiber.hpp"
 #include "snow/function.hpp"
 #include "snow/numeric.hpp"
+#include <string>
 
 static VALUE fiber_function(const CallFrame* here, Value self, Value it) {
 	printf("fiber started\n");
@@ -13,6 +16,80 @@ static VALUE fiber_function(const CallFrame* here, Value self, Value it) {
 	return integer_to_value(2);
 }
 
+static bool generator_would_block = false;
+static VALUE generator_result = NULL;
+
+static VALUE generator_function(const CallFrame* here, VALUE self, VALUE it) {
+	// Resumed directly, so the empty channel must not park it, and yielding must not hand it to the scheduler.
+	try {
+		channel_receive(self);
+	}
+	catch (ExceptionPtr ex) {
+		generator_would_block = true;
+	}
+	fiber_yield();
+	return integer_to_value(1);
+}
+
+static VALUE spawned_function(const CallFrame* here, VALUE self, VALUE it) {
+	Value generator = create_bound_method(self, create_function(generator_function, snow::sym("generator")));
+	generator_result = fiber_resume(create_fiber(generator), NULL);
+	return SN_NIL;
+}
+
+static std::string schedule_log;
+
+static VALUE yielding_function(const CallFrame* here, VALUE self, VALUE it) {
+	int n = value_to_integer(self);
+	schedule_log += (char)('a' + n);
+	fiber_yield();
+	schedule_log += (char)('A' + n);
+	return SN_NIL;
+}
+
+static VALUE parking_function(const CallFrame* here, VALUE self, VALUE it) {
+	schedule_log += 'p';
+	fiber_park();
+	schedule_log += 'P';
+	return SN_NIL;
+}
+
+static VALUE unparking_function(const CallFrame* here, VALUE self, VALUE it) {
+	ObjectPtr<Fiber> parked = self;
+	schedule_log += fiber_is_parked(parked) ? 'u' : '!';
+	fiber_unpark(parked);
+	schedule_log += fiber_is_parked(parked) ? '!' : 'U';
+	return SN_NIL;
+}
+
+static VALUE early_wakeup_function(const CallFrame* here, VALUE self, VALUE it) {
+	// The wakeup arrives before the park, so the park must return at once.
+	schedule_log += 'w';
+	fiber_unpark(get_current_fiber());
+	fiber_park();
+	schedule_log += 'W';
+	return SN_NIL;
+}
+
+static Value idle_parked_fiber = NULL;
+static int idle_calls = 0;
+
+static VALUE idle_parking_function(const CallFrame* here, VALUE self, VALUE it) {
+	schedule_log += 'i';
+	idle_parked_fiber = get_current_fiber();
+	fiber_park();
+	schedule_log += 'I';
+	return SN_NIL;
+}
+
+static bool unparking_idle_handler() {
+	++idle_calls;
+	if (idle_parked_fiber == NULL) return false;
+	fiber_unpark(idle_parked_fiber);
+	idle_parked_fiber = NULL;
+	return true;
+}
+
 BEGIN_TESTS()
 BEGIN_GROUP("Basic")
 
@@ -30,5 +107,52 @@ STORY("fiber 1", {
 	TEST_EQ(yielded_value, integer_to_value(2));
 });
 
+STORY("spawned fiber resumes a generator that receives from a channel", {
+	Value spawned = create_bound_method(create_channel(), create_function(spawned_function, snow::sym("spawned")));
+	fiber_spawn(spawned);
+	fiber_run_scheduler();
+	TEST_EQ(generator_would_block, true);
+	TEST_EQ(generator_result, integer_to_value(1));
+});
+
+END_GROUP()
+BEGIN_GROUP("Scheduler")
+
+STORY("spawned fibers run in order and take turns when they yield", {
+	schedule_log.clear();
+	Value yielding = create_function(yielding_function, snow::sym("yielding"));
+	fiber_spawn(create_bound_method(integer_to_value(0), yielding));
+	fiber_spawn(create_bound_method(integer_to_value(1), yielding));
+	fiber_run_scheduler();
+	TEST_EQ(schedule_log, "abAB");
+});
+
+STORY("a parked fiber runs again after it is unparked", {
+	schedule_log.clear();
+	ObjectPtr<Fiber> parker = fiber_spawn(create_function(parking_function, snow::sym("parking")));
+	fiber_spawn(create_bound_method(parker, create_function(unparking_function, snow::sym("unparking"))));
+	fiber_run_scheduler();
+	TEST_EQ(schedule_log, "puUP");
+	TEST_EQ(fiber_is_parked(parker), false);
+});
+
+STORY("unparking a running fiber makes its next park return immediately", {
+	schedule_log.clear();
+	fiber_spawn(create_function(early_wakeup_function, snow::sym("early_wakeup")));
+	fiber_run_scheduler();
+	TEST_EQ(schedule_log, "wW");
+});
+
+STORY("the idle handler is called when every fiber is parked", {
+	schedule_log.clear();
+	idle_calls = 0;
+	fiber_set_scheduler_idle_handler(unparking_idle_handler);
+	fiber_spawn(create_function(idle_parking_function, snow::sym("idle_parking")));
+	fiber_run_scheduler();
+	fiber_set_scheduler_idle_handler(NULL);
+	TEST_EQ(schedule_log, "iI");
+	TEST_EQ(idle_calls, 2); // once to unpark, once more to report that nothing is left
+});
+
 END_GROUP()
 END_TESTS()
\ No newline at end of file
@@ -39,7 +39,9 @@ namespace snow { namespace test {
 	#define END_TESTS() } } }
 	#define BEGIN_GROUP(NAME) begin_group(NAME); {
 	#define END_GROUP() }
-	#define STORY_VAR _story_ ##__LINE__
+	#define STORY_VAR_CONCAT(A, B) A ## B
+	#define STORY_VAR_AT(LINE) STORY_VAR_CONCAT(_story_, LINE)
+	#define STORY_VAR STORY_VAR_AT(__LINE__)
 	#define STORY(DESCRIPTION, BLOCK) Story STORY_VAR = begin_story(DESCRIPTION); try BLOCK catch(TestFailure failure) { fail_story(STORY_VAR, failure); } finish_story(STORY_VAR)
 	#define TEST(EXPR) if (!(EXPR)) { throw TestFailure(#EXPR, __file__, __LINE); }
 	#define TEST_EQ(A, B) if (!((A) == (B))) { throw TestFailure::Op("==", #A, A, #B, B, __FILE__, __LINE__); }
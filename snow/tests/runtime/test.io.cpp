@@ -0,0 +1,171 @@
+#include "test.hpp"
+#include "snow/array.hpp"
+#include "snow/class.hpp"
+#include "snow/exception.hpp"
+#include "snow/fiber.hpp"
+#include "snow/function.hpp"
+#include "snow/module.hpp"
+#include "snow/numeric.hpp"
+#include "snow/str.hpp"
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static Value io_module() {
+	return import(create_string_constant("../../lib/io"));
+}
+
+static Value get_property(Value self, const char* name) {
+	MethodQueryResult method;
+	class_lookup_method(get_class(self), snow::sym(name), &method);
+	return call(method.result, self, 0, NULL);
+}
+
+static Value open_file(const char* path, const char* mode) {
+	Value args[] = { create_string(path), create_string(mode) };
+	return call_method(get_property(io_module(), "File"), snow::sym("open"), 2, args);
+}
+
+static int64_t now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_seconds(float seconds) {
+	Value args[] = { float_to_value(seconds) };
+	call_method(io_module(), snow::sym("sleep"), 1, args);
+}
+
+static std::string io_log;
+
+static VALUE sleeping_function(const CallFrame* here, VALUE self, VALUE it) {
+	sleep_seconds(0.05f);
+	io_log += 's';
+	return SN_NIL;
+}
+
+static VALUE running_function(const CallFrame* here, VALUE self, VALUE it) {
+	io_log += 'r';
+	return SN_NIL;
+}
+
+static VALUE timed_read_function(const CallFrame* here, VALUE self, VALUE it) {
+	Value args[] = { integer_to_value(1) };
+	try {
+		call_method(self, snow::sym("read"), 1, args);
+		io_log += 'd';
+	}
+	catch (ExceptionPtr ex) {
+		io_log += 't';
+	}
+	return SN_NIL;
+}
+
+static VALUE queued_read_function(const CallFrame* here, VALUE self, VALUE it) {
+	ObjectPtr<Array> task = self; // @(file, name)
+	Value n[] = { integer_to_value(1) };
+	ObjectPtr<String> data = call_method(array_get(task, 0), snow::sym("read"), 1, n);
+	char c = '?';
+	string_copy_to(data, &c, 1);
+	io_log += (char)value_to_integer(array_get(task, 1));
+	io_log += c;
+	return SN_NIL;
+}
+
+static void spawn_queued_reader(Value file, char name) {
+	Value task[] = { file, integer_to_value(name) };
+	fiber_spawn(create_bound_method(create_array_from_range(task, task + 2), create_function(queued_read_function, snow::sym("queued_read"))));
+}
+
+static VALUE queued_write_function(const CallFrame* here, VALUE self, VALUE it) {
+	const char* chunks[] = { "x", "y" };
+	for (size_t i = 0; i < 2; ++i) {
+		Value data[] = { create_string(chunks[i]) };
+		call_method(self, snow::sym("write"), 1, data);
+		call_method(self, snow::sym("flush"), 0, NULL);
+		sleep_seconds(0.01f); // let the first reader finish before the next byte arrives
+	}
+	return SN_NIL;
+}
+
+BEGIN_TESTS()
+BEGIN_GROUP("Event loop")
+
+STORY("a sleeping fiber lets other fibers run, and wakes up after its timer", {
+	io_log.clear();
+	fiber_spawn(create_function(sleeping_function, snow::sym("sleeping")));
+	fiber_spawn(create_function(running_function, snow::sym("running")));
+	int64_t start = now_ms();
+	fiber_run_scheduler();
+	TEST_EQ(io_log, "rs");
+	TEST_EQ(now_ms() - start >= 50, true);
+});
+
+STORY("a read with a timeout raises when nothing arrives", {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/snow-test-io-%d", (int)getpid());
+	unlink(path);
+	TEST_EQ(mkfifo(path, 0600), 0);
+	Value reader = open_file(path, "r+"); // opening for reading and writing does not wait for a writer
+	object_set_property_or_define_method(reader, snow::sym("nonblock"), SN_TRUE);
+	object_set_property_or_define_method(reader, snow::sym("timeout"), float_to_value(0.05f));
+
+	io_log.clear();
+	fiber_spawn(create_bound_method(reader, create_function(timed_read_function, snow::sym("timed_read"))));
+	fiber_run_scheduler();
+	TEST_EQ(io_log, "t");
+	call_method(reader, snow::sym("close"), 0, NULL);
+	unlink(path);
+});
+
+STORY("a write with a timeout raises when the pipe stays full", {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/snow-test-io-%d", (int)getpid());
+	unlink(path);
+	TEST_EQ(mkfifo(path, 0600), 0);
+	Value reader = open_file(path, "r+");
+	Value writer = open_file(path, "w");
+	object_set_property_or_define_method(writer, snow::sym("nonblock"), SN_TRUE);
+	object_set_property_or_define_method(writer, snow::sym("timeout"), float_to_value(0.05f));
+
+	// Larger than any pipe buffer, and nothing reads it.
+	std::string big(1 << 20, 'x');
+	Value data = create_string_with_size(big.data(), big.size());
+	bool raised = false;
+	try {
+		call_method(writer, snow::sym("write"), 1, &data);
+	}
+	catch (ExceptionPtr ex) {
+		raised = true;
+	}
+	TEST_EQ(raised, true);
+	call_method(writer, snow::sym("close"), 0, NULL);
+	call_method(reader, snow::sym("close"), 0, NULL);
+	unlink(path);
+});
+
+STORY("fibers waiting to read the same descriptor are woken in turn", {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/snow-test-io-%d", (int)getpid());
+	unlink(path);
+	TEST_EQ(mkfifo(path, 0600), 0);
+	Value reader = open_file(path, "r+");
+	Value writer = open_file(path, "w");
+	object_set_property_or_define_method(reader, snow::sym("nonblock"), SN_TRUE);
+
+	io_log.clear();
+	spawn_queued_reader(reader, 'A');
+	spawn_queued_reader(reader, 'B');
+	fiber_spawn(create_bound_method(writer, create_function(queued_write_function, snow::sym("queued_write"))));
+	fiber_run_scheduler();
+	TEST_EQ(io_log, "AxBy");
+	call_method(writer, snow::sym("close"), 0, NULL);
+	call_method(reader, snow::sym("close"), 0, NULL);
+	unlink(path);
+});
+
+END_GROUP()
+END_TESTS()
@@ -0,0 +1,69 @@
+#include "test.hpp"
+#include "snow/array.hpp"
+#include "snow/gc.hpp"
+#include "snow/isolate.hpp"
+#include "snow/numeric.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+static const int NUM_COLLECTORS = 2;
+static const int COLLECTIONS_PER_THREAD = 20;
+
+static void collect_repeatedly(Isolate* isolate, std::atomic<int>* finished) {
+	for (int i = 0; i < COLLECTIONS_PER_THREAD; ++i) {
+		isolate_collect_garbage(isolate);
+	}
+	++*finished;
+}
+
+// Several threads at once, so that their stops of the same isolate have to take turns.
+static void start_collectors(std::vector<std::thread>& threads, std::atomic<int>& finished) {
+	for (int i = 0; i < NUM_COLLECTORS; ++i) {
+		threads.push_back(std::thread(collect_repeatedly, get_current_isolate(), &finished));
+	}
+}
+
+static void join_collectors(std::vector<std::thread>& threads) {
+	for (std::thread& thread: threads) {
+		thread.join();
+	}
+}
+
+BEGIN_TESTS()
+BEGIN_GROUP("Remote collection")
+
+STORY("other threads can collect an isolate while it runs", {
+	Value* kept = gc_create_root(create_array());
+	std::atomic<int> finished(0);
+	std::vector<std::thread> collectors;
+	start_collectors(collectors, finished);
+	while (finished < NUM_COLLECTORS) {
+		create_array_with_size(16); // garbage, and allocating polls for safepoints
+	}
+	join_collectors(collectors);
+	array_push(*kept, integer_to_value(1));
+	TEST_EQ(array_size(*kept), 1);
+	gc_free_root(kept);
+});
+
+STORY("other threads can collect an isolate while it is in a safe region", {
+	Value* kept = gc_create_root(create_array());
+	std::atomic<int> finished(0);
+	std::vector<std::thread> collectors;
+	start_collectors(collectors, finished);
+	{
+		SafeRegion waiting;
+		while (finished < NUM_COLLECTORS) {
+			usleep(1000);
+		}
+	}
+	join_collectors(collectors);
+	array_push(*kept, integer_to_value(1));
+	TEST_EQ(array_size(*kept), 1);
+	gc_free_root(kept);
+});
+
+END_GROUP()
+END_TESTS()